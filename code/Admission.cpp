@@ -0,0 +1,80 @@
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Admission.cpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include "Admission.hpp"
+
+#include <cmath>
+
+namespace fcgi {
+
+    const double Admission::DEFAULT_TARGET = 0.005;
+    const double Admission::DEFAULT_INTERVAL = 0.100;
+
+    Admission::Admission ( double target, double interval )
+        : myTarget(target), myInterval(interval), myAbove(0.0),
+          myRefusing(false), myNext(0.0), myCount(0)
+    {
+    }
+
+    double Admission::target () const
+    {
+        return (myTarget);
+    }
+
+    double Admission::interval () const
+    {
+        return (myInterval);
+    }
+
+    void Admission::sample ( double delay, double now )
+    {
+        if ( delay < myTarget )
+        {
+            myAbove = 0.0;
+            myRefusing = false;
+            return;
+        }
+        if ( myAbove == 0.0 ) {
+            myAbove = now + myInterval; return;
+        }
+        if ( myRefusing || (now < myAbove) ) {
+            return;
+        }
+          // start refusing, faster if we were refusing a moment ago.
+        myRefusing = true;
+        if ( (myCount > 2) && ((now - myNext) < 8*myInterval) ) {
+            myCount -= 2;
+        }
+        else {
+            myCount = 1;
+        }
+        myNext = now;
+    }
+
+    bool Admission::admit ( double now )
+    {
+        if ( !myRefusing || (now < myNext) ) {
+            return (true);
+        }
+          // CoDel control law: refuse more often the longer it lasts.
+        ++myCount;
+        myNext = now + myInterval / std::sqrt(double(myCount));
+        return (false);
+    }
+
+    bool Admission::overloaded () const
+    {
+        return (myRefusing);
+    }
+
+}
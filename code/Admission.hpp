@@ -0,0 +1,91 @@
+#ifndef _fcgi_Admission_hpp__
+#define _fcgi_Admission_hpp__
+
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Admission.hpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include <cstddef>
+
+namespace fcgi {
+
+    /*!
+     * @group application
+     * @brief Sheds load once requests queue for too long (CoDel).
+     *
+     * The application reports how long each request waited between its
+     * @c FCGI_BEGIN_REQUEST record and the start of its handler.  Short
+     * bursts are absorbed, but once the delay stays above @c target() for a
+     * whole @c interval(), new requests are refused, at a rate that grows
+     * until the delay drops below the target again.  Refused requests are
+     * answered with @c FCGI_OVERLOADED right away, so the gateway can fail
+     * over instead of waiting.  This requires an executor: requests handled
+     * inside @c Application::feed() never wait in the application.
+     *
+     * @see Application::admission()
+     */
+    class Admission
+    {
+        /* class data. */
+    public:
+        static const double DEFAULT_TARGET;
+        static const double DEFAULT_INTERVAL;
+
+        /* data. */
+    private:
+        double myTarget;
+        double myInterval;
+
+          // time at which a delay above target becomes overload, or 0.
+        double myAbove;
+
+          // refusing requests, next refusal time and count.
+        bool myRefusing;
+        double myNext;
+        size_t myCount;
+
+        /* construction. */
+    public:
+        /*!
+         * @param target Acceptable queueing delay, in seconds.
+         * @param interval Time the delay may exceed @a target before
+         *  requests are refused, in seconds.
+         */
+        explicit Admission ( double target=DEFAULT_TARGET,
+                             double interval=DEFAULT_INTERVAL );
+
+        /* methods. */
+    public:
+        double target () const;
+        double interval () const;
+
+        /*!
+         * @brief Record that a request waited @a delay seconds.
+         * @param now Current time, in seconds.
+         */
+        void sample ( double delay, double now );
+
+        /*!
+         * @brief Decide whether to accept a new request.
+         * @param now Current time, in seconds.
+         */
+        bool admit ( double now );
+
+        /*!
+         * @brief Check if requests are currently being refused.
+         */
+        bool overloaded () const;
+    };
+
+}
+
+#endif /* _fcgi_Admission_hpp__ */
@@ -12,12 +12,43 @@
  */
 
 #include "Application.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <limits>
 #include <sstream>
 
+namespace {
+
+      // response to requests that missed their deadline.
+    const fcgi::Records& unavailable ()
+    {
+        static const fcgi::Records records = fcgi::Records()
+            .stdo("Status: 503 Service Unavailable\r\n\r\n")
+            .stdo()
+            .end_request();
+        return (records);
+    }
+
+}
+
+namespace {
+
+    const size_t MAXIMUM_CONTENT_LENGTH = (1 << 16)-1;
+
+}
+
 namespace fcgi {
 
     Application::Application ()
-        : myRequests(), mySelection(myRequests.end())
+        : myRequests(), mySelection(0), myRecord(0), myQuerying(false),
+          mySpoolThreshold(0), myRopes(false), myInput(0), myExecutor(0),
+          myAdmission(0), myBatchSize(0), myBatchDelay(0.0),
+          myBatchStart(0.0),
+          myCompletions(&Application::notify, this),
+          myMaxConns(1), myMaxReqs(1), myMpxsConns(false),
+          myGenerations(0), myFlights(&myLocalFlights)
     {
         ::fcgi_iwire_init(&myISettings, &myIWire);
         myIWire.object = static_cast<void*>(this);
@@ -28,85 +59,736 @@ namespace fcgi {
         myIWire.accept_query_data   = &Application::accept_query_data;
         myIWire.accept_query        = &Application::accept_query;
         myIWire.accept_request      = &Application::accept_request;
+        myIWire.cancel_request      = &Application::cancel_request;
         myIWire.accept_headers      = &Application::accept_headers;
         myIWire.finish_headers      = &Application::finish_headers;
         myIWire.accept_content_stdi = &Application::accept_content_stdi;
+        myIWire.accept_content_data = &Application::accept_content_data;
         
         ::fcgi_owire_init(&myOSettings, &myOWire);
         myOWire.object = static_cast<void*>(this);
           // Register callbacks.
         myOWire.write_stream = &Application::write_stream;
+        myOWire.write_parts  = &Application::write_parts;
+    }
+
+    Application::~Application ()
+    {
+          // executor threads would call wake() on a destroyed object.
+        if ( myCompletions.outstanding() != 0 ) {
+            std::terminate();
+        }
+          // hand groups led from this connection over to other connections.
+        if ( myFlights != &myLocalFlights )
+        {
+            const std::vector<Request*> members = myFlights->members(*this);
+            for ( size_t i = 0; (i < members.size()); ++i ) {
+                land(*members[i], false);
+            }
+        }
+        ::fcgi_owire_clear(&myOWire);
     }
 
     void Application::afeed ( const char * data, size_t size )
     {
+        if ( broken() ) {
+            return;
+        }
         ::fcgi_iwire_feed(&myIWire, data, size);
+        flush_batch();
     }
 
     void Application::afeed ( const std::string& buffer )
     {
+        afeed(buffer.data(), buffer.size());
+    }
+
+    void Application::afeed ( const Buffer& buffer )
+    {
+        if ( broken() ) {
+            return;
+        }
+        myInput = &buffer;
         ::fcgi_iwire_feed(&myIWire, buffer.data(), buffer.size());
+        myInput = 0;
+        flush_batch();
+    }
+
+    size_t Application::pending () const
+    {
+        return (::fcgi_owire_pending(&myOWire));
+    }
+
+    bool Application::broken () const
+    {
+        return (myOWire.error != ::fcgi_owire_error_none);
+    }
+
+    Pool& Application::pool ()
+    {
+        return (myRequests.pool());
+    }
+
+    size_t Application::resume ()
+    {
+        const size_t pending = ::fcgi_owire_resume(&myOWire);
+        if ( pending == 0 ) {
+            drained();
+        }
+        return (pending);
+    }
+
+    bool Application::more () const
+    {
+        return (myOWire.more != 0);
+    }
+
+    void Application::spool ( size_t threshold )
+    {
+        mySpoolThreshold = threshold;
+    }
+
+    void Application::rope ( bool enabled )
+    {
+        myRopes = enabled;
+    }
+
+    void Application::prioritize ( const std::string& prefix, int priority )
+    {
+        myPrefixes.push_back(std::make_pair(prefix, priority));
+    }
+
+    void Application::deadline_header ( const std::string& name )
+    {
+        myDeadlineHeader = name;
+    }
+
+    void Application::classify ( Request& request )
+    {
+        if ( request.role() == Role::authorizer() ) {
+            request.priority(std::numeric_limits<int>::max());
+        }
+        else if ( !myPrefixes.empty() )
+        {
+            const std::string path = request.head().get("SCRIPT_NAME");
+            size_t longest = 0;
+            for ( size_t i = 0; (i < myPrefixes.size()); ++i )
+            {
+                const std::string& prefix = myPrefixes[i].first;
+                if ( (prefix.size() >= longest) &&
+                     (path.compare(0, prefix.size(), prefix) == 0) )
+                {
+                    longest = prefix.size();
+                    request.priority(myPrefixes[i].second);
+                }
+            }
+        }
+        if ( !myDeadlineHeader.empty() )
+        {
+            const std::string value = request.head().get(myDeadlineHeader);
+            const double deadline = std::strtod(value.c_str(), 0);
+              // "nan" would never expire and break the executor's ordering.
+            if ( std::isfinite(deadline) && (deadline > 0.0) ) {
+                request.deadline(deadline);
+            }
+        }
+    }
+
+    void Application::limits
+        ( size_t connections, size_t requests, bool multiplex )
+    {
+        myMaxConns = connections;
+        myMaxReqs = requests;
+        myMpxsConns = multiplex;
     }
 
     void Application::reply ( const std::string& name, const std::string& data )
     {
-          // build the reply (name,value) pair.
-        std::ostringstream stream;
-        stream
-            << (char)name.size() << (char)data.size() << name << data;
-        const std::string reply = stream.str();
-          // send it.
-        ::fcgi_owire_reply(&myOWire, reply.data(), reply.size());
+        if ( !myQuerying )
+        {
+            ::fcgi_owire_reply_pair(&myOWire,
+                name.data(), name.size(), data.data(), data.size());
+            return;
+        }
+        char head[8];
+        const size_t size =
+            ::fcgi_owire_pair_head(head, name.size(), data.size());
+          // keep records under the maximum content length.
+        if ( (myReplies.size() + size + name.size() + data.size())
+             > MAXIMUM_CONTENT_LENGTH ) {
+            flush_replies();
+        }
+        myReplies.append(head, size);
+        myReplies.append(name);
+        myReplies.append(data);
+    }
+
+    size_t Application::asend
+        ( const char ** parts, const size_t * sizes, size_t count )
+    {
+        size_t used = 0;
+        for ( size_t i = 0; (i < count); ++i )
+        {
+            const size_t sent = asend(parts[i], sizes[i]);
+            used += sent;
+              // the rest is queued until resume().
+            if ( sent < sizes[i] ) {
+                break;
+            }
+        }
+        return (used);
+    }
+
+    void Application::query
+        ( const std::string& name, const std::string& )
+    {
+        std::ostringstream value;
+        if ( name == "FCGI_MAX_CONNS" ) {
+            value << myMaxConns;
+        }
+        else if ( name == "FCGI_MAX_REQS" ) {
+            value << myMaxReqs;
+        }
+        else if ( name == "FCGI_MPXS_CONNS" ) {
+            value << (myMpxsConns? 1 : 0);
+        }
+        else {
+            return;
+        }
+        reply(name, value.str());
+    }
+
+    void Application::executor ( Executor * executor )
+    {
+        myExecutor = executor;
+    }
+
+    void Application::dispatch ( Job * job )
+    {
+        if ( myExecutor == 0 )
+        {
+            job->execute();
+            job->complete();
+            delete job;
+            return;
+        }
+        myCompletions.expect(job);
+        myExecutor->submit(job);
+    }
+
+    void Application::dispatch ( Request& request, Job * job )
+    {
+        Request *const requests[] = { &request };
+        dispatch(requests, 1, job);
+    }
+
+    void Application::dispatch
+        ( Request * const * requests, size_t count, Job * job )
+    {
+        job->myMembers.reserve(count);
+        for ( size_t i = 0; (i < count); ++i )
+        {
+            const Request& request = *requests[i];
+            if ( (i == 0) || (request.priority() > job->priority()) ) {
+                job->priority(request.priority());
+            }
+              // the earliest deadline, if any, applies.
+            if ( (request.deadline() != 0.0) &&
+                 ((job->deadline() == 0.0) ||
+                  (request.deadline() < job->deadline())) )
+            {
+                job->deadline(request.deadline());
+            }
+            const Job::Member member =
+                { request.id(), request.generation(), request.arrival() };
+            job->myMembers.push_back(member);
+        }
+        dispatch(job);
+    }
+
+    void Application::admission ( Admission * admission )
+    {
+        myAdmission = admission;
+    }
+
+    void Application::batch ( size_t size, double delay )
+    {
+        myBatchSize = size;
+        myBatchDelay = delay;
+          // don't strand requests queued under the previous settings.
+        if ( myBatch.size() >= myBatchSize ) {
+            flush_batch();
+        }
+    }
+
+    void Application::flush_batch ()
+    {
+        if ( myBatch.empty() ) {
+            return;
+        }
+          // handlers may end requests, which removes them from the batch.
+        std::vector<Request*> batch;
+        batch.swap(myBatch);
+        const bool selected = (mySelection != 0);
+        handle_batch(&batch[0], batch.size());
+          // the handler may have ended the request being parsed.
+        mySelection = selected? myRequests.find(myRecord) : 0;
+          // keep the allocation for the next batch.
+        batch.clear();
+        if ( myBatch.empty() ) {
+            myBatch.swap(batch);
+        }
+    }
+
+    void Application::flush_batch ( const Request& request )
+    {
+        if ( std::find(myBatch.begin(), myBatch.end(), &request)
+            != myBatch.end() )
+        {
+            flush_batch();
+        }
+    }
+
+    void Application::handle_batch
+        ( Request * const * requests, size_t count )
+    {
+        for ( size_t i = 0; (i < count); ++i )
+        {
+              // let the handler use the overloads without a request.
+            mySelection = requests[i];
+            end_of_head(*requests[i]);
+        }
+    }
+
+    size_t Application::collect ()
+    {
+        size_t count = 0;
+        for ( Job * job; ((job=myCompletions.take()) != 0); ++count )
+        {
+            const std::vector<Job::Member>& members = job->myMembers;
+              // time each request spent queued on the executor.
+            if ( myAdmission != 0 )
+            {
+                const double now = Job::now();
+                for ( size_t i = 0; (i < members.size()); ++i ) {
+                    myAdmission->sample(
+                        job->started() - members[i].arrival, now);
+                }
+            }
+            if ( !job->expired() ) {
+                job->complete();
+            }
+            else {
+                for ( size_t i = 0; (i < members.size()); ++i )
+                {
+                    Request *const request =
+                        this->request(members[i].id, members[i].generation);
+                      // unless the request ended in the mean time.
+                    if ( request != 0 ) {
+                        reject(*request);
+                    }
+                }
+            }
+            delete job;
+        }
+        return (count);
+    }
+
+    size_t Application::outstanding () const
+    {
+        return (myCompletions.outstanding());
+    }
+
+    Request * Application::request ( Request::Id id ) const
+    {
+        return (myRequests.find(id));
+    }
+
+    Request * Application::request
+        ( Request::Id id, Request::Generation generation ) const
+    {
+        Request *const request = myRequests.find(id);
+        if ( (request == 0) || (request->generation() != generation) ) {
+            return (0);
+        }
+        return (request);
     }
 
     void Application::output ( const std::string& output )
     {
           // ignore invalid records.
-        if ( mySelection == myRequests.end() ) {
+        if ( mySelection == 0 ) {
             return;
         }
-        Request& request = mySelection->second;
-        ::fcgi_owire_stdo(&myOWire, request.id(), output.data(), output.size());
+        Application::output(*mySelection, output);
+    }
+
+    void Application::output ( const Buffer& output )
+    {
+        if ( mySelection == 0 ) {
+            return;
+        }
+        Application::output(*mySelection, output);
     }
 
     void Application::output ()
     {
-        if ( mySelection == myRequests.end() ) {
+        if ( mySelection == 0 ) {
             return;
         }
-        Request& request = mySelection->second;
-        ::fcgi_owire_stdo(&myOWire, request.id(), 0, 0);
+        Application::output(*mySelection);
     }
 
     void Application::errors ( const std::string& errors )
     {
-        if ( mySelection == myRequests.end() ) {
+        if ( mySelection == 0 ) {
             return;
         }
-        Request& request = mySelection->second;
-        ::fcgi_owire_stde(&myOWire, request.id(), errors.data(), errors.size());
+        Application::errors(*mySelection, errors);
     }
 
     void Application::errors ()
     {
-        if ( mySelection == myRequests.end() ) {
+        if ( mySelection == 0 ) {
             return;
         }
-        Request& request = mySelection->second;
-        ::fcgi_owire_stde(&myOWire, request.id(), 0, 0);
+        Application::errors(*mySelection);
     }
 
     void Application::end_request ( uint32_t astatus, uint8_t pstatus )
     {
-        if ( mySelection == myRequests.end() ) {
+        if ( mySelection == 0 ) {
+            return;
+        }
+        Application::end_request(*mySelection, astatus, pstatus);
+    }
+
+    void Application::end_request ( const Records& records )
+    {
+        if ( mySelection == 0 ) {
+            return;
+        }
+        Application::end_request(*mySelection, records);
+    }
+
+    void Application::output ( Request& request, const std::string& output )
+    {
+          // ignore requests that already ended.
+        if ( !owns(request) ) {
+            return;
+        }
+        ::fcgi_owire_stdo(&myOWire, request.id(), output.data(), output.size());
+        if ( request.capturing() ) {
+            request.transcript().stdo(output);
+        }
+    }
+
+    void Application::output ( Request& request, const Buffer& output )
+    {
+          // asend() bypasses the writer, which drops output once broken.
+        if ( !owns(request) || broken() ) {
+            return;
+        }
+        size_t used = 0;
+        while ( used < output.size() )
+        {
+            const size_t size =
+                std::min(output.size()-used, MAXIMUM_CONTENT_LENGTH);
+            char head[8];
+            ::fcgi_owire_head(head, request.id(), 6, size);
+            ::fcgi_owire_write(&myOWire, head, 8, 1);
+              // preserve ordering: once output is pending, queue everything.
+            size_t sent = 0;
+            if ( ::fcgi_owire_pending(&myOWire) == 0 ) {
+                sent = asend(output, used, size);
+            }
+            if ( sent < size ) {
+                ::fcgi_owire_write(&myOWire,
+                    output.data()+used+sent, size-sent, 1);
+            }
+            if ( request.capturing() ) {
+                request.transcript().record(6, output.data()+used, size);
+            }
+            used += size;
+        }
+    }
+
+    void Application::output ( Request& request )
+    {
+        if ( !owns(request) ) {
+            return;
+        }
+        ::fcgi_owire_stdo(&myOWire, request.id(), 0, 0);
+        if ( request.capturing() ) {
+            request.transcript().stdo();
+        }
+    }
+
+    void Application::output ( Request& request,
+        const char ** parts, const size_t * sizes, size_t count )
+    {
+        if ( !owns(request) ) {
+            return;
+        }
+        ::fcgi_owire_stdo_parts(&myOWire, request.id(), parts, sizes, count);
+        if ( request.capturing() )
+        {
+            for ( size_t i = 0; (i < count); ++i )
+            {
+                if ( sizes[i] > 0 ) {
+                    request.transcript().record(6, parts[i], sizes[i]);
+                }
+            }
+        }
+    }
+
+    void Application::errors ( Request& request, const std::string& errors )
+    {
+        if ( !owns(request) ) {
+            return;
+        }
+        ::fcgi_owire_stde(&myOWire, request.id(), errors.data(), errors.size());
+        if ( request.capturing() ) {
+            request.transcript().stde(errors);
+        }
+    }
+
+    void Application::errors ( Request& request )
+    {
+        if ( !owns(request) ) {
+            return;
+        }
+        ::fcgi_owire_stde(&myOWire, request.id(), 0, 0);
+        if ( request.capturing() ) {
+            request.transcript().stde();
+        }
+    }
+
+    void Application::end_request
+        ( Request& request, uint32_t astatus, uint8_t pstatus )
+    {
+        if ( !owns(request) ) {
             return;
         }
-        Request& request = mySelection->second;
         ::fcgi_owire_end_request(&myOWire, request.id(), astatus, pstatus);
-          // clear contents, but keep buffers.
-        request.clear();
-          // invalidate selection.
-        mySelection = myRequests.end();
+        if ( request.capturing() ) {
+            request.transcript().end_request(astatus, pstatus);
+        }
+        release(request);
+    }
+
+    void Application::end_request ( Request& request, const Records& records )
+    {
+        if ( !owns(request) ) {
+            return;
+        }
+          // patch request ID, send everything at once.
+        myRecords.resize(records.size());
+        if ( !myRecords.empty() )
+        {
+            records.copy(&myRecords[0], request.id());
+            ::fcgi_owire_write(&myOWire,
+                myRecords.data(), myRecords.size(), 0);
+        }
+        if ( request.capturing() ) {
+            request.transcript().append(records);
+        }
+        release(request);
+    }
+
+    void Application::capture ( Request& request )
+    {
+        if ( !owns(request) ) {
+            return;
+        }
+        request.capturing(true);
+    }
+
+    bool Application::coalesce ( Request& request, const std::string& key )
+    {
+        if ( !owns(request) || myFlights->joined(request) ) {
+            return (false);
+        }
+        const bool waiting = myFlights->join(*this, request, key);
+        if ( !waiting ) {
+            capture(request);
+        }
+        return (waiting);
+    }
+
+    void Application::flights ( Flights * flights )
+    {
+        myFlights = (flights != 0)? flights : &myLocalFlights;
+    }
+
+    bool Application::waiting ( const Request& request ) const
+    {
+        return (myFlights->waiting(request));
+    }
+
+    void Application::body
+        ( Request& request, const char * data, size_t size )
+    {
+        if ( !myRopes )
+        {
+            if ( !store(request.body(), request.spool(), data, size) ) {
+                fail(request, "Request body lost: spool file failed.\r\n");
+                return;
+            }
+        }
+          // reference the input buffer when the chunk comes from it.
+        else if ( (myInput != 0) && (data >= myInput->data()) &&
+                  (data+size <= myInput->data()+myInput->size()) )
+        {
+            request.rope().append(*myInput, data-myInput->data(), size);
+        }
+        else {
+            request.rope().append(data, size);
+        }
+        body(request);
+    }
+
+    void Application::data
+        ( Request& request, const char * data, size_t size )
+    {
+        if ( !store(request.data(), request.data_spool(), data, size) ) {
+            fail(request, "Request data lost: spool file failed.\r\n");
+            return;
+        }
+        this->data(request);
+    }
+
+    bool Application::store ( std::string& buffer, Spool& spool,
+        const char * data, size_t size ) const
+    {
+          // move buffered content to a file once it grows too large.
+        if ( !spool.is_open() && (mySpoolThreshold > 0) &&
+             ((buffer.size() + size) > mySpoolThreshold) && spool.open() )
+        {
+            if ( spool.write(buffer.data(), buffer.size()) == buffer.size() ) {
+                std::string().swap(buffer);
+            }
+            else {
+                spool.close();
+            }
+        }
+        size_t used = 0;
+        if ( spool.is_open() )
+        {
+            used = spool.write(data, size);
+              // on error, move content back to memory.
+            if ( used < size )
+            {
+                const char *const view = spool.data();
+                if ( view != 0 ) {
+                    buffer.assign(view, spool.size());
+                }
+                else
+                {
+                    buffer.resize(spool.size());
+                    if ( !buffer.empty() &&
+                         (spool.read(0, &buffer[0], buffer.size())
+                          < buffer.size()) )
+                    {
+                          // never continue with a truncated body.
+                        std::string().swap(buffer);
+                        spool.close();
+                        return (false);
+                    }
+                }
+                spool.close();
+            }
+        }
+        buffer.append(data+used, size-used);
+        return (true);
+    }
+
+    void Application::fail ( Request& request, const std::string& reason )
+    {
+        errors(request, reason);
+        errors(request);
+        output(request);
+        end_request(request, 1);
+    }
+
+    void Application::land ( Request& request, bool replay )
+    {
+          // replay the leader's output for all waiters.
+        if ( replay && myFlights->leads(request) )
+        {
+            const std::vector<Flights::Member> waiters =
+                myFlights->land(request);
+            for ( size_t i = 0; (i < waiters.size()); ++i )
+            {
+                waiters[i].application->end_request
+                    (*waiters[i].request, request.transcript());
+            }
+            return;
+        }
+          // no usable output, hand over to the next waiter.
+        const Flights::Member next = myFlights->leave(request);
+        if ( next.request != 0 )
+        {
+            next.application->capture(*next.request);
+            next.application->promoted(*next.request);
+        }
+    }
+
+    void Application::reject ( Request& request )
+    {
+        request.rejected(true);
+        end_request(request, unavailable());
+    }
+
+    void Application::promoted ( Request& request )
+    {
+        end_request(request, 1);
+    }
+
+    void Application::flush_replies ()
+    {
+        if ( myReplies.empty() ) {
+            return;
+        }
+          // a single large pair may still need multiple records.
+        for ( size_t used = 0; (used < myReplies.size()); )
+        {
+            const size_t pass =
+                std::min(myReplies.size()-used, MAXIMUM_CONTENT_LENGTH);
+            ::fcgi_owire_reply(&myOWire,
+                myReplies.data()+used, static_cast<uint16_t>(pass));
+            used += pass;
+        }
+        myReplies.clear();
+    }
+
+    bool Application::owns ( const Request& request ) const
+    {
+          // a recycled object passes too, see request(Id,Generation).
+        return (myRequests.find(request.id()) == &request);
+    }
+
+    void Application::release ( Request& request )
+    {
+          // hand over the output copy before the request is recycled.
+        if ( request.capturing() )
+        {
+            request.capturing(false);
+            captured(request, request.transcript());
+        }
+        if ( !myFlights->empty() ) {
+            land(request, !request.aborted() && !request.rejected());
+        }
+          // records for this request may still be in the parser.
+        if ( mySelection == &request ) {
+            mySelection = 0;
+        }
+        if ( !myBatch.empty() ) {
+            myBatch.erase(std::remove(myBatch.begin(), myBatch.end(),
+                &request), myBatch.end());
+        }
+          // free the request ID for reuse.
+        myRequests.release(request.id());
     }
 
     void Application::accept_record
@@ -119,28 +801,26 @@ namespace fcgi {
         }
           // don't create a request object for management records.
         if ( request == 0 ) {
+            application.myQuerying = true;
             return;
         }
-          // lookup the request object for the request ID.
+          // lookup the request object, only FCGI_BEGIN_REQUEST creates it.
+        application.myRecord = request;
         application.mySelection = application.myRequests.find(request);
-          // might be the first use of this request ID.
-        if ( application.mySelection == application.myRequests.end() )
-        {
-            application.mySelection = application.myRequests.insert
-                (Mapping(request, Request(request))).first;
-        }
         // TODO: forward content length.
     }
 
     void Application::finish_record ( ::fcgi_iwire * stream )
     {
         Application& application = *static_cast<Application*>(stream->object);
-          // ignore invalid records.
-        if ( application.mySelection == application.myRequests.end() ) {
-            return;
+          // answer all queries in the record at once.
+        if ( application.myQuerying )
+        {
+            application.flush_replies();
+            application.myQuerying = false;
         }
           // clear selection.
-        application.mySelection = application.myRequests.end();
+        application.mySelection = 0;
     }
 
     void Application::accept_query_name
@@ -173,11 +853,27 @@ namespace fcgi {
         ( ::fcgi_iwire * stream, int role, int flags )
     {
         Application& application = *static_cast<Application*>(stream->object);
-          // ignore invalid records.
-        if ( application.mySelection == application.myRequests.end() ) {
+          // don't create a request object for management records.
+        if ( application.myRecord == 0 ) {
             return;
         }
-        Request& request = application.mySelection->second;
+        const double now = Job::now();
+          // shed load, ignoring the rest of the request's records.
+        if ( (application.myAdmission != 0) &&
+             !application.myAdmission->admit(now) )
+        {
+            ::fcgi_owire_end_request(&application.myOWire,
+                application.myRecord, 0, FCGI_OVERLOADED);
+            application.mySelection = 0;
+            return;
+        }
+          // might be the first use of this request ID.
+        application.mySelection =
+            &application.myRequests.acquire(application.myRecord);
+        Request& request = *application.mySelection;
+          // the object may have served an earlier request with this ID.
+        request.generation(++application.myGenerations);
+        request.arrival(now);
         if ( role == 1 ) {
             request.role(Role::responder());
         }
@@ -189,15 +885,31 @@ namespace fcgi {
         }
     }
 
+    void Application::cancel_request ( ::fcgi_iwire * stream )
+    {
+        Application& application = *static_cast<Application*>(stream->object);
+          // ignore requests that already ended.
+        if ( application.mySelection == 0 ) {
+            return;
+        }
+        Request& request = *application.mySelection;
+        request.aborted(true);
+        application.abort(request);
+          // reclaim the request, unless the handler already ended it.
+        if ( application.owns(request) ) {
+            application.end_request(request);
+        }
+    }
+
     void Application::accept_headers
         ( ::fcgi_iwire * stream, const char * data, size_t size )
     {
         Application& application = *static_cast<Application*>(stream->object);
           // ignore invalid records.
-        if ( application.mySelection == application.myRequests.end() ) {
+        if ( application.mySelection == 0 ) {
             return;
         }
-        Request& request = application.mySelection->second;
+        Request& request = *application.mySelection;
         request.head().feed(data, size);
     }
 
@@ -205,12 +917,39 @@ namespace fcgi {
     {
         Application& application = *static_cast<Application*>(stream->object);
           // ignore invalid records.
-        if ( application.mySelection == application.myRequests.end() ) {
+        if ( application.mySelection == 0 ) {
             return;
         }
-        Request& request = application.mySelection->second;
+        Request& request = *application.mySelection;
         request.prepared(true);
-        application.end_of_head(request);
+        application.classify(request);
+          // don't waste time on responses nobody waits for.
+        if ( (request.deadline() != 0.0) && (Job::now() > request.deadline()) )
+        {
+            application.reject(request); return;
+        }
+        if ( (application.myAdmission != 0) &&
+             (application.myExecutor == 0) )
+        {
+            const double now = Job::now();
+            application.myAdmission->sample(now - request.arrival(), now);
+        }
+        if ( application.myBatchSize == 0 ) {
+            application.end_of_head(request); return;
+        }
+          // wait for more requests, within limits.
+        if ( application.myBatch.empty() ) {
+            application.myBatchStart =
+                (application.myBatchDelay == 0.0)? 0.0 : Job::now();
+        }
+        application.myBatch.push_back(&request);
+        if ( (application.myBatch.size() >= application.myBatchSize) ||
+             ((application.myBatchDelay != 0.0) &&
+              ((Job::now() - application.myBatchStart)
+               >= application.myBatchDelay)) )
+        {
+            application.flush_batch();
+        }
     }
 
     void Application::accept_content_stdi
@@ -218,26 +957,60 @@ namespace fcgi {
     {
         Application& application = *static_cast<Application*>(stream->object);
           // ignore invalid records.
-        if ( application.mySelection == application.myRequests.end() ) {
+        if ( application.mySelection == 0 ) {
             return;
         }
         // TODO: make sure partial record does not produce {size=0}.
           // accept stream contents.
-        Request& request = application.mySelection->second;
+        Request& request = *application.mySelection;
+          // the handler must see the headers first.
+        application.flush_batch(request);
+        if ( application.mySelection != &request ) {
+            return;
+        }
         if ( size == 0 ) {
+            request.complete(true);
             application.end_of_body(request);
         }
         else {
-            request.body().append(data, size);
-            application.body(request);
+            application.body(request, data, size);
+        }
+    }
+
+    void Application::accept_content_data
+        ( ::fcgi_iwire * stream, const char * data, size_t size )
+    {
+        Application& application = *static_cast<Application*>(stream->object);
+          // ignore invalid records.
+        if ( application.mySelection == 0 ) {
+            return;
+        }
+        Request& request = *application.mySelection;
+        if ( size == 0 ) {
+            application.end_of_data(request);
+        }
+        else {
+            application.data(request, data, size);
         }
     }
 
-    void Application::write_stream
+    size_t Application::write_stream
         ( ::fcgi_owire * stream, const char * data, size_t size )
     {
         Application& application = *static_cast<Application*>(stream->object);
-        application.asend(data, size);
+        return (application.asend(data, size));
+    }
+
+    size_t Application::write_parts ( ::fcgi_owire * stream,
+        const char ** parts, const size_t * sizes, size_t count )
+    {
+        Application& application = *static_cast<Application*>(stream->object);
+        return (application.asend(parts, sizes, count));
+    }
+
+    void Application::notify ( void * object )
+    {
+        static_cast<Application*>(object)->wake();
     }
 
 }
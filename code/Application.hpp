@@ -15,24 +15,26 @@
  */
 
 #include "fcgi.h"
+#include "Admission.hpp"
+#include "Buffer.hpp"
+#include "Executor.hpp"
+#include "Flights.hpp"
+#include "Records.hpp"
 #include "Request.hpp"
+#include "Requests.hpp"
 
 #include <map>
+#include <vector>
 
 namespace fcgi {
 
     class Application
     {
-        /* nested types. */
-    private:
-        typedef std::map<Request::Id, Request> Requests;
-        typedef Requests::value_type Mapping;
-        typedef Requests::iterator Selection;
-
         /* data. */
     private:
         Requests myRequests;
-        Selection mySelection;
+        Request * mySelection;
+        Request::Id myRecord;
 
         ::fcgi_iwire_settings myISettings; ::fcgi_iwire myIWire;
         ::fcgi_owire_settings myOSettings; ::fcgi_owire myOWire;
@@ -41,14 +43,71 @@ namespace fcgi {
         std::string myQName;
         std::string myQData;
 
+          // replies to FCGI_GET_VALUES, sent in a single record.
+        bool myQuerying;
+        std::string myReplies;
+
+          // body size past which content is spilled to a file.
+        size_t mySpoolThreshold;
+
+          // keep bodies as slices of the buffer being parsed, if any.
+        bool myRopes;
+        const Buffer * myInput;
+
+          // handler work off-loaded to other threads.
+        Executor * myExecutor;
+
+          // load shedding, see admission().
+        Admission * myAdmission;
+
+          // requests waiting for handle_batch(), see batch().
+        std::vector<Request*> myBatch;
+        size_t myBatchSize;
+        double myBatchDelay;
+        double myBatchStart;
+        Completions myCompletions;
+
+          // values reported to FCGI_GET_VALUES.
+        size_t myMaxConns;
+        size_t myMaxReqs;
+        bool myMpxsConns;
+
+          // request classification, see classify().
+        std::vector< std::pair<std::string, int> > myPrefixes;
+        std::string myDeadlineHeader;
+
           // buffer for param.
         std::string myPName;
         std::string myPData;
 
+          // buffer for pre-encoded records.
+        std::string myRecords;
+
+          // last value of Request::generation().
+        Request::Generation myGenerations;
+
+          // requests attached to each other by coalesce().
+        Flights myLocalFlights;
+        Flights * myFlights;
+
         /* construction. */
     public:
         Application ();
 
+        /*!
+         * @brief Destroy the application.
+         *
+         * Executor threads still use the application while jobs are
+         * @c outstanding(), so the owner must call @c collect() until
+         * @c outstanding() is 0 first.  Destroying the application earlier
+         * calls @c std::terminate().
+         */
+        virtual ~Application ();
+
+    private:
+        Application ( const Application& );
+        Application& operator= ( const Application& );
+
         /* methods. */
     public:
         /*!
@@ -61,44 +120,514 @@ namespace fcgi {
          */
         void afeed ( const std::string& buffer );
 
+        /*!
+         * @brief Process new record(s) received from peer (the application).
+         *
+         * With @c rope() enabled, body content refers to @a buffer instead of
+         * being copied, so do not modify it while it is not @c unique().
+         */
+        void afeed ( const Buffer& buffer );
+
+        /*!
+         * @brief Get the amount of output not yet accepted by @c asend().
+         */
+        size_t pending () const;
+
+        /*!
+         * @brief Check if output was lost because the writer ran out of
+         *  memory.
+         *
+         * The record stream is then corrupt: further input is ignored,
+         * further output is dropped, and the connection must be closed.
+         */
+        bool broken () const;
+
+        /*!
+         * @brief Access the pool of recycled request objects.
+         *
+         * Use this to adjust how much buffer memory is kept between requests.
+         */
+        Pool& pool ();
+
+        /*!
+         * @brief Send pending output, once the peer (the gateway) can accept
+         *  more data.
+         * @return Number of bytes still pending.
+         */
+        size_t resume ();
+
+        /*!
+         * @brief Run jobs passed to @c dispatch() on @a executor.
+         *
+         * Use 0 (the default) to run jobs immediately, on the calling thread.
+         * The executor must outlive the application, and its jobs must be
+         * collected before the application is destroyed.
+         */
+        void executor ( Executor * executor );
+
+        /*!
+         * @brief Run @a job off the I/O thread.
+         *
+         * @c Job::execute() runs on the executor, then @c Job::complete() runs
+         * in the next call to @c collect().  Takes ownership of @a job.
+         * Without an executor, both run before this returns.
+         */
+        void dispatch ( Job * job );
+
+        /*!
+         * @brief Run @a job for @a request off the I/O thread.
+         *
+         * The job inherits the request's priority and deadline, which
+         * executors such as @c PriorityPool use to order jobs.  If the
+         * deadline passes before the job starts, the job is dropped and the
+         * request receives a 503 response instead.
+         */
+        void dispatch ( Request& request, Job * job );
+
+        /*!
+         * @brief Run @a job for @a count requests off the I/O thread.
+         *
+         * Use this for work that serves several requests at once, such as in
+         * @c handle_batch().  The job takes the highest priority and the
+         * earliest deadline of @a requests.  If the deadline passes before
+         * the job starts, all requests that are still in flight receive a
+         * 503 response instead.
+         */
+        void dispatch
+            ( Request * const * requests, size_t count, Job * job );
+
+        /*!
+         * @brief Refuse new requests while @a admission reports overload.
+         *
+         * The time between each request's @c FCGI_BEGIN_REQUEST record and
+         * the start of its handler is reported to @a admission: the start of
+         * its job for requests passed to @c dispatch() with a request when an
+         * executor is set, @c end_of_head() otherwise.  Refused requests end
+         * with @c FCGI_OVERLOADED before their headers are parsed.  Use 0
+         * (the default) to accept all requests.  @a admission must outlive
+         * the application.
+         *
+         * @warning Shedding only works with an executor.  Without one,
+         *  handlers run inside @c feed(), right after the request's records
+         *  are parsed, so the reported delay is close to 0 and never exceeds
+         *  the target; the backlog then waits in the socket, where the
+         *  application can't measure it.
+         */
+        void admission ( Admission * admission );
+
+        /*!
+         * @brief Hand requests whose headers were received to
+         *  @c handle_batch() in groups of up to @a size requests.
+         *
+         * A batch is handed over at the end of each @c afeed() call, when it
+         * holds @a size requests, when its first request waited @a delay
+         * seconds (0 for no limit), or before its requests get body content.
+         * Use a @a size of 0 (the default) to call @c end_of_head() as soon
+         * as each request's headers are received.
+         */
+        void batch ( size_t size, double delay=0.0 );
+
+        /*!
+         * @brief Complete jobs that ran on the executor.
+         * @return Number of jobs completed.
+         *
+         * Call this on the I/O thread after @c wake().
+         */
+        size_t collect ();
+
+        /*!
+         * @brief Obtain the number of dispatched jobs not collected yet.
+         *
+         * Jobs whose executor thread is still calling @c wake() count too,
+         * so the application may be destroyed once this is 0.
+         */
+        size_t outstanding () const;
+
+        /*!
+         * @brief Locate an in-flight request.
+         * @return The request, or 0 if @a id is not in use.
+         */
+        Request * request ( Request::Id id ) const;
+
+        /*!
+         * @brief Locate an in-flight request, unless its request object was
+         *  recycled for a new request.
+         * @return The request, or 0 if it ended.
+         * @see Request::generation()
+         */
+        Request * request
+            ( Request::Id id, Request::Generation generation ) const;
+
+        /*!
+         * @brief Spill request bodies larger than @a threshold bytes to a
+         *  temporary file.
+         *
+         * Smaller bodies are still kept in @c Request::body(), larger ones are
+         * moved to @c Request::spool().  A threshold of 0 (the default) keeps
+         * all bodies in memory.  If the file cannot be created or written,
+         * the content is kept in memory.  If spooled content cannot be read
+         * back into memory either, the request ends with a message on
+         * @c FCGI_STDERR and an application status of 1.
+         */
+        void spool ( size_t threshold );
+
+        /*!
+         * @brief Keep request bodies in @c Request::rope() instead of
+         *  @c Request::body().
+         *
+         * Content fed with @c afeed(const Buffer&) is referenced rather than
+         * copied, other content is copied once.  The spool threshold does not
+         * apply to ropes.  Disabled by default.
+         */
+        void rope ( bool enabled );
+
+        /*!
+         * @brief Give requests whose @c SCRIPT_NAME starts with @a prefix a
+         *  priority of @a priority.
+         *
+         * The longest matching prefix wins, other requests have a priority
+         * of 0.  Authorizer requests always come first, as they gate other
+         * requests.
+         */
+        void prioritize ( const std::string& prefix, int priority );
+
+        /*!
+         * @brief Read request deadlines from CGI variable @a name.
+         *
+         * The value is a time in seconds since the Unix epoch, fractions
+         * allowed; other values are ignored.  Deadlines are ignored by
+         * default (an empty name).
+         *
+         * Clients set @c HTTP_* variables, and could jump the queue with a
+         * near deadline.  Only use a variable that the gateway sets itself,
+         * for example @c HTTP_X_REQUEST_DEADLINE when the gateway replaces
+         * the client's @c X-Request-Deadline header.
+         */
+        void deadline_header ( const std::string& name );
+
+        /*!
+         * @brief Set the values reported to the gateway's management queries.
+         * @param connections Value of @c FCGI_MAX_CONNS, the number of
+         *  concurrent connections the server accepts.
+         * @param requests Value of @c FCGI_MAX_REQS, the number of
+         *  concurrent requests the server accepts.
+         * @param multiplex Value of @c FCGI_MPXS_CONNS, whether each
+         *  connection accepts concurrent requests.
+         *
+         * The default values are 1, 1 and @c false.
+         */
+        void limits ( size_t connections, size_t requests, bool multiplex );
+
+        /*!
+         * @brief Answer a management query.
+         *
+         * When called from @c query(), all answers to the same
+         * @c FCGI_GET_VALUES record are sent in a single
+         * @c FCGI_GET_VALUES_RESULT record.
+         */
         void reply ( const std::string& name, const std::string& data );
 
+        /*!
+         * @brief Send output for the request whose record is being processed.
+         *
+         * These overloads may only be used from within notifications (e.g.
+         * @c end_of_body()).  Use the overloads that take a @c Request to
+         * respond at any other time.
+         */
         void output ( const std::string& output );
+
+        /*!
+         * @brief Send output without copying it.
+         *
+         * Record contents are handed to @c asend(const Buffer&,size_t,size_t)
+         * so the transport may keep a reference to @a output until it is
+         * done with it, instead of copying it.
+         */
+        void output ( const Buffer& output );
+
         void output ();
         void errors ( const std::string& output );
         void errors ();
 
         void end_request ( uint32_t astatus=0, uint8_t pstatus=0 );
 
+        /*!
+         * @brief Send a canned response and end the request.
+         *
+         * The records are sent in a single write.  They should end with an
+         * @c FCGI_END_REQUEST record, no more output may follow.
+         */
+        void end_request ( const Records& records );
+
+        /*!
+         * @brief Send output for @a request.
+         *
+         * Unlike the overloads above, these may be used at any time, including
+         * outside of @c afeed(), to complete multiplexed requests out of order.
+         * @a request is recycled by @c end_request(), do not use it
+         * afterwards: output is ignored only until the request object serves
+         * a new request.  To complete a request later, keep its ID and
+         * @c Request::generation() instead, and look it up again with
+         * @c request(Request::Id,Request::Generation).
+         */
+        void output ( Request& request, const std::string& output );
+        void output ( Request& request, const Buffer& output );
+        void output ( Request& request );
+
+        /*!
+         * @brief Send output gathered from @a count fragments, without
+         *  joining them first.
+         */
+        void output ( Request& request,
+            const char ** parts, const size_t * sizes, size_t count );
+
+        void errors ( Request& request, const std::string& errors );
+        void errors ( Request& request );
+
+        void end_request
+            ( Request& request, uint32_t astatus=0, uint8_t pstatus=0 );
+        void end_request ( Request& request, const Records& records );
+
+        /*!
+         * @brief Keep a copy of the records sent for @a request.
+         *
+         * When the request ends, the copy is passed to @c captured(), which
+         * may store it to replay it for other requests with
+         * @c end_request(Request&,const Records&).
+         */
+        void capture ( Request& request );
+
+        /*!
+         * @brief Attach @a request to the in-flight request with the same
+         *  @a key, if any.
+         * @return @c true if @a request is now waiting: do not handle it, it
+         *  will receive the same output as the first request with that key.
+         *  @c false if @a request leads: handle it as usual.
+         *
+         * Use this to protect expensive handlers from bursts of identical
+         * requests.  The leader's output is captured (see @c capture()) and
+         * replayed for all waiters when it ends.  If the gateway aborts the
+         * leader, or its deadline passes, the next waiter takes over, see
+         * @c promoted().
+         *
+         * Only requests of this connection are coalesced, unless
+         * @c flights() is shared with other connections.
+         */
+        bool coalesce ( Request& request, const std::string& key );
+
+        /*!
+         * @brief Coalesce requests with those of all applications sharing
+         *  @a flights.
+         *
+         * Most gateways send one request per connection, so requests of a
+         * single connection are never coalesced.  Share one object between
+         * the applications of all connections served by the same thread
+         * (leaders end waiters of other connections directly).  Use 0 (the
+         * default) to coalesce requests of this connection only.  Change
+         * this before requests are coalesced.  @a flights must outlive the
+         * application.
+         */
+        void flights ( Flights * flights );
+
+        /*!
+         * @brief Check if @a request waits on another one, see
+         *  @c coalesce().
+         */
+        bool waiting ( const Request& request ) const;
+
+    private:
+        bool owns ( const Request& request ) const;
+        void release ( Request& request );
+        void land ( Request& request, bool replay );
+        void reject ( Request& request );
+        void flush_replies ();
+        void flush_batch ();
+        void flush_batch ( const Request& request );
+        bool store ( std::string& buffer, Spool& spool,
+            const char * data, size_t size ) const;
+        void fail ( Request& request, const std::string& reason );
+
     protected:
-        virtual void asend ( const char * data, size_t size )
+        /*!
+         * @brief Check if more records follow the data being written.
+         *
+         * Use this in @c asend() to send with @c MSG_MORE (or keep @c TCP_CORK
+         * set) until the end of each exchange, so that small records are
+         * packed into full segments.
+         */
+        bool more () const;
+
+        /*!
+         * @brief Notification that @c resume() sent all pending output.
+         */
+        virtual void drained () {}
+
+        /*!
+         * @brief Notification that jobs are ready for @c collect().
+         *
+         * This is called from executor threads.  Override it to wake up the
+         * I/O thread (e.g. by writing to an @c eventfd it polls).  Whatever
+         * it uses must outlive the application.
+         */
+        virtual void wake () {}
+
+        /*!
+         * @brief Write data to the peer.
+         * @return Number of bytes accepted.  Any remainder is kept until
+         *  @c resume() is called.
+         */
+        virtual size_t asend ( const char * data, size_t size )
         {
-            asend(std::string(data, size));
+            asend(std::string(data, size)); return (size);
         }
 
         virtual void asend ( const std::string& data ) {}
 
-         /*!
+        /*!
+         * @brief Write @a count fragments to the peer, back to back.
+         * @return Number of bytes accepted, counting from the start of the
+         *  first fragment.
+         *
+         * The default implementation calls @c asend() for each fragment.
+         * Override this to gather them in a single system call (e.g. with
+         * @c writev()).  At most 16 fragments are passed at a time.
+         */
+        virtual size_t asend
+            ( const char ** parts, const size_t * sizes, size_t count );
+
+        /*!
+         * @brief Write [@a offset, @a offset+@a size) of @a buffer to the
+         *  peer.
+         * @return Number of bytes accepted.
+         *
+         * Override this to send large buffers without copying them.  Keep a
+         * copy of @a buffer for as long as its contents are in use.
+         */
+        virtual size_t asend
+            ( const Buffer& buffer, size_t offset, size_t size )
+        {
+            return (asend(buffer.data()+offset, size));
+        }
+
+        /*!
          * @brief Notification a query has arrived.
+         *
+         * The default implementation answers @c FCGI_MAX_CONNS,
+         * @c FCGI_MAX_REQS and @c FCGI_MPXS_CONNS from the values set by
+         * @c limits(), and ignores other names.
          */
         virtual void query
-            ( const std::string& name, const std::string& data ) = 0;
+            ( const std::string& name, const std::string& data );
 
         /*!
          * @brief Notification that all the headers were received.
          */
         virtual void end_of_head ( Request& request ) = 0;
 
+        /*!
+         * @brief Notification that the headers of several requests were
+         *  received, see @c batch().
+         *
+         * Override this to look up data for all @a requests at once, then
+         * pass the work to @c dispatch(Request*const*,size_t,Job*).  The
+         * batch is a plain array rather than a container so that it maps
+         * directly onto a @c std::span where available.  The default
+         * implementation calls @c end_of_head() for each request, in the
+         * order they were received.
+         */
+        virtual void handle_batch
+            ( Request * const * requests, size_t count );
+
         /*!
          * @brief Notification that additional body content is available.
          */
         virtual void body ( Request& request ) {}
 
+        /*!
+         * @brief Notification that a chunk of body content has arrived.
+         * @param data Chunk contents, only valid for the duration of the call.
+         * @param size Size of the chunk, in bytes.
+         *
+         * The default implementation appends the chunk to @c Request::body()
+         * (or @c Request::spool() or @c Request::rope(), see @c spool() and
+         * @c rope()) and calls
+         * @c body(Request&).  Override this to process the body as
+         * it arrives (e.g. to hash it or forward it) instead of buffering it:
+         * @c Request::body() then stays empty, and memory use does not depend
+         * on the size of the upload.
+         */
+        virtual void body ( Request& request, const char * data, size_t size );
+
         /*!
          * @brief Notification that all the body content was received.
          */
         virtual void end_of_body ( Request& request ) = 0;
 
+        /*!
+         * @brief Notification that additional file content is available.
+         *
+         * Filters receive the file to filter in the @c FCGI_DATA stream,
+         * after the request body.
+         */
+        virtual void data ( Request& ) {}
+
+        /*!
+         * @brief Notification that a chunk of file content has arrived.
+         *
+         * The default implementation appends the chunk to @c Request::data()
+         * (or @c Request::data_spool(), see @c spool()) and calls
+         * @c data(Request&).  Override this to filter the file as it arrives.
+         * @see body(Request&,const char*,size_t)
+         */
+        virtual void data ( Request& request, const char * data, size_t size );
+
+        /*!
+         * @brief Notification that all the file content was received.
+         */
+        virtual void end_of_data ( Request& ) {}
+
+        /*!
+         * @brief Notification that the gateway aborted a request.
+         *
+         * Use this to cancel any work in progress for @a request.  Unless
+         * this ends the request itself, an @c FCGI_END_REQUEST record is sent
+         * when it returns.  Either way, @a request is recycled and no more
+         * content is delivered for it.
+         */
+        virtual void abort ( Request& ) {}
+
+        /*!
+         * @brief Notification that a request passed to @c capture() ended.
+         * @param records All records sent for @a request, ending with its
+         *  @c FCGI_END_REQUEST record.
+         *
+         * Called before @a request is recycled.  Check
+         * @c Request::aborted() and @c Request::rejected() before re-using
+         * the output: the output of a request the gateway aborted is likely
+         * incomplete, and rejected requests only got a 503 response.
+         */
+        virtual void captured ( Request&, const Records& ) {}
+
+        /*!
+         * @brief Notification that a waiting request must now be handled,
+         *  because the request it waited on was aborted or rejected.
+         *
+         * @a request is the new leader of its group, see @c coalesce().  The
+         * default implementation ends it with an application status of 1.
+         */
+        virtual void promoted ( Request& request );
+
+        /*!
+         * @brief Set the priority and deadline of a request whose headers
+         *  were received.
+         *
+         * Called before @c end_of_head().  The default implementation uses
+         * the request's role, @c prioritize() and @c deadline_header().
+         * Requests whose deadline already passed are answered with a 503
+         * response and never reach the handler.
+         */
+        virtual void classify ( Request& request );
+
         /* class methods. */
     private:
         static void accept_record
@@ -113,6 +642,7 @@ namespace fcgi {
 
         static void accept_request
             ( ::fcgi_iwire * stream, int role, int flags );
+        static void cancel_request ( ::fcgi_iwire * stream );
 
         static void accept_headers
             ( ::fcgi_iwire * stream, const char * data, size_t size );
@@ -120,9 +650,15 @@ namespace fcgi {
 
         static void accept_content_stdi
             ( ::fcgi_iwire * stream, const char * data, size_t size );
+        static void accept_content_data
+            ( ::fcgi_iwire * stream, const char * data, size_t size );
 
-        static void write_stream
+        static size_t write_stream
             ( ::fcgi_owire * stream, const char * data, size_t size );
+        static size_t write_parts ( ::fcgi_owire * stream,
+            const char ** parts, const size_t * sizes, size_t count );
+
+        static void notify ( void * object );
     };
 
 }
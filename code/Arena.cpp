@@ -0,0 +1,112 @@
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Arena.cpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include "Arena.hpp"
+
+namespace {
+
+      // enough for any fundamental type.
+    const size_t ALIGNMENT = 16;
+
+    size_t align ( size_t size )
+    {
+        return ((size + (ALIGNMENT-1)) & ~(ALIGNMENT-1));
+    }
+
+}
+
+namespace fcgi {
+
+    const size_t Arena::DEFAULT_BLOCK_SIZE;
+
+    Arena::Arena ( size_t block_size )
+        : myBlocks(0), myCursor(0), myLimit(0), myBlockSize(block_size)
+    {
+    }
+
+    Arena::~Arena ()
+    {
+        shrink();
+    }
+
+    void * Arena::allocate ( size_t size )
+    {
+        size = align(size);
+        if ( size > size_t(myLimit-myCursor) ) {
+            grow(size);
+        }
+        void *const data = myCursor;
+        myCursor += size;
+        return (data);
+    }
+
+    void Arena::deallocate ( void * data, size_t size )
+    {
+        char *const start = static_cast<char*>(data);
+        if ( (start + align(size)) == myCursor ) {
+            myCursor = start;
+        }
+    }
+
+    void Arena::reset ()
+    {
+        if ( myBlocks == 0 ) {
+            return;
+        }
+          // merge blocks, the next request probably needs as much.
+        if ( myBlocks->next != 0 )
+        {
+            const size_t size = capacity();
+            shrink();
+            grow(size);
+        }
+        myCursor = reinterpret_cast<char*>(myBlocks) + align(sizeof(Block));
+    }
+
+    size_t Arena::capacity () const
+    {
+        size_t capacity = 0;
+        const Block * block = myBlocks;
+        for ( ; (block != 0); block = block->next ) {
+            capacity += block->size;
+        }
+        return (capacity);
+    }
+
+    void Arena::shrink ()
+    {
+        while ( myBlocks != 0 )
+        {
+            Block *const block = myBlocks;
+            myBlocks = block->next;
+            ::operator delete(block);
+        }
+        myCursor = myLimit = 0;
+    }
+
+    void Arena::grow ( size_t size )
+    {
+        if ( size < myBlockSize ) {
+            size = myBlockSize;
+        }
+        char *const data = static_cast<char*>
+            (::operator new(align(sizeof(Block)) + size));
+        Block *const block = reinterpret_cast<Block*>(data);
+        block->next = myBlocks;
+        block->size = size;
+        myBlocks = block;
+        myCursor = data + align(sizeof(Block));
+        myLimit = myCursor + size;
+    }
+
+}
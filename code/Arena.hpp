@@ -0,0 +1,197 @@
+#ifndef _fcgi_Arena_hpp__
+#define _fcgi_Arena_hpp__
+
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Arena.hpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include <cstddef>
+#include <new>
+
+namespace fcgi {
+
+    /*!
+     * @group application
+     * @brief Monotonic memory for per-request objects.
+     *
+     * Allocations are carved out of large blocks and, except for the most
+     * recent one, never freed one by one.  @c reset() releases everything in
+     * one step.  When the arena needed
+     * more than one block, the blocks are merged into a single one of the
+     * same total size, so a steady stream of similar requests stops
+     * allocating from the global heap altogether.
+     */
+    class Arena
+    {
+        /* nested types. */
+    private:
+        struct Block
+        {
+            Block * next;
+            size_t size;
+        };
+
+        /* class data. */
+    public:
+        static const size_t DEFAULT_BLOCK_SIZE = 4096;
+
+        /* data. */
+    private:
+        Block * myBlocks;
+        char * myCursor;
+        char * myLimit;
+        size_t myBlockSize;
+
+        /* construction. */
+    public:
+        explicit Arena ( size_t block_size=DEFAULT_BLOCK_SIZE );
+        ~Arena ();
+
+    private:
+        Arena ( const Arena& );
+        Arena& operator= ( const Arena& );
+
+        /* methods. */
+    public:
+        /*!
+         * @brief Obtain @a size bytes, suitably aligned for any type.
+         * @throw std::bad_alloc The global heap is exhausted.
+         */
+        void * allocate ( size_t size );
+
+        /*!
+         * @brief Give back memory obtained from @c allocate().
+         *
+         * Only the most recent allocation is reclaimed, so short-lived
+         * temporaries don't grow the arena.  Other memory is reclaimed by
+         * @c reset().
+         */
+        void deallocate ( void * data, size_t size );
+
+        /*!
+         * @brief Forget all allocations, keeping the memory for re-use.
+         */
+        void reset ();
+
+        /*!
+         * @brief Obtain the amount of memory reserved by the arena.
+         */
+        size_t capacity () const;
+
+        /*!
+         * @brief Release all memory, see @c reset().
+         */
+        void shrink ();
+
+    private:
+        void grow ( size_t size );
+    };
+
+    /*!
+     * @group application
+     * @brief Standard allocator drawing from an @c Arena.
+     *
+     * Memory is reclaimed by @c Arena::reset(), see @c Arena::deallocate().
+     * Containers must be cleared before their arena is reset.
+     */
+    template<typename T>
+    class Allocator
+    {
+        /* nested types. */
+    public:
+        typedef T value_type;
+        typedef T * pointer;
+        typedef const T * const_pointer;
+        typedef T& reference;
+        typedef const T& const_reference;
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        template<typename U>
+        struct rebind
+        {
+            typedef Allocator<U> other;
+        };
+
+        /* data. */
+    private:
+        Arena * myArena;
+
+        /* construction. */
+    public:
+        explicit Allocator ( Arena& arena )
+            : myArena(&arena)
+        {}
+
+        template<typename U>
+        Allocator ( const Allocator<U>& other )
+            : myArena(&other.arena())
+        {}
+
+        /* methods. */
+    public:
+        Arena& arena () const
+        {
+            return (*myArena);
+        }
+
+        pointer address ( reference value ) const
+        {
+            return (&value);
+        }
+
+        const_pointer address ( const_reference value ) const
+        {
+            return (&value);
+        }
+
+        pointer allocate ( size_type count, const void * =0 )
+        {
+            return (static_cast<pointer>(myArena->allocate(count*sizeof(T))));
+        }
+
+        void deallocate ( pointer data, size_type count )
+        {
+            myArena->deallocate(data, count*sizeof(T));
+        }
+
+        size_type max_size () const
+        {
+            return (size_type(-1) / sizeof(T));
+        }
+
+        void construct ( pointer place, const T& value )
+        {
+            ::new (static_cast<void*>(place)) T(value);
+        }
+
+        void destroy ( pointer place )
+        {
+            place->~T();
+        }
+    };
+
+    template<typename T, typename U>
+    bool operator== ( const Allocator<T>& lhs, const Allocator<U>& rhs )
+    {
+        return (&lhs.arena() == &rhs.arena());
+    }
+
+    template<typename T, typename U>
+    bool operator!= ( const Allocator<T>& lhs, const Allocator<U>& rhs )
+    {
+        return (&lhs.arena() != &rhs.arena());
+    }
+
+}
+
+#endif /* _fcgi_Arena_hpp__ */
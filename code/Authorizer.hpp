@@ -38,12 +38,12 @@ namespace fcgi {
                 handle_authorization(request);
             }
             else {
-                errors(
+                errors(request,
                     "This is an authorizer, not a responder or filter."
                 );
-                errors();
-                output();
-                end_request(1);
+                errors(request);
+                output(request);
+                end_request(request, 1);
             }
         }
 
@@ -0,0 +1,120 @@
+#ifndef _fcgi_Buffer_hpp__
+#define _fcgi_Buffer_hpp__
+
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Buffer.hpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief Shared ownership of output buffers.
+ */
+
+#include <algorithm>
+#include <string>
+
+namespace fcgi {
+
+    /*!
+     * @brief Reference-counted handle to an immutable buffer.
+     *
+     * Hand a buffer over to the library without copying its contents.  The
+     * contents are released when the last handle goes away, which allows
+     * the transport to keep the buffer alive until the kernel is done with
+     * it (e.g. when sending with @c MSG_ZEROCOPY).
+     *
+     * @note Reference counting is not thread-safe.
+     */
+    class Buffer
+    {
+        /* nested types. */
+    private:
+        struct Block
+        {
+            std::string content;
+            size_t references;
+        };
+
+        /* data. */
+    private:
+        Block * myBlock;
+
+        /* construction. */
+    public:
+        Buffer ()
+            : myBlock(new Block())
+        {
+            myBlock->references = 1;
+        }
+
+        /*!
+         * @brief Take ownership of @a content, leaving it empty.
+         */
+        explicit Buffer ( std::string& content )
+            : myBlock(new Block())
+        {
+            myBlock->references = 1;
+            myBlock->content.swap(content);
+        }
+
+        Buffer ( const Buffer& other )
+            : myBlock(other.myBlock)
+        {
+            ++myBlock->references;
+        }
+
+        ~Buffer ()
+        {
+            if ( --myBlock->references == 0 ) {
+                delete myBlock;
+            }
+        }
+
+        /* methods. */
+    public:
+        const char * data () const
+        {
+            return (myBlock->content.data());
+        }
+
+        size_t size () const
+        {
+            return (myBlock->content.size());
+        }
+
+        /*!
+         * @brief Check if this is the only handle to the buffer.
+         *
+         * A unique buffer may safely be modified or re-used.
+         */
+        bool unique () const
+        {
+            return (myBlock->references == 1);
+        }
+
+        /*!
+         * @brief Access the contents, for re-use.
+         * @pre @c unique() is @c true.
+         */
+        std::string& content ()
+        {
+            return (myBlock->content);
+        }
+
+        /* operators. */
+    public:
+        Buffer& operator= ( const Buffer& other )
+        {
+            Buffer copy(other);
+            std::swap(myBlock, copy.myBlock);
+            return (*this);
+        }
+    };
+
+}
+
+#endif /* _fcgi_Buffer_hpp__ */
@@ -0,0 +1,201 @@
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Cache.cpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include "Cache.hpp"
+
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+
+namespace fcgi {
+
+    const size_t Cache::DEFAULT_LIMIT;
+
+    Cache::Cache ( std::time_t ttl, std::time_t grace, size_t limit )
+        : myTTL(ttl), myGrace(grace), myLimit(limit)
+    {
+        myVariables.push_back("REQUEST_METHOD");
+        myVariables.push_back("SERVER_NAME");
+        myVariables.push_back("HTTP_HOST");
+        myVariables.push_back("SCRIPT_NAME");
+        myVariables.push_back("PATH_INFO");
+        myVariables.push_back("QUERY_STRING");
+    }
+
+    std::time_t Cache::ttl () const
+    {
+        return (myTTL);
+    }
+
+    std::time_t Cache::grace () const
+    {
+        return (myGrace);
+    }
+
+    void Cache::vary ( const std::string& name )
+    {
+        myVariables.push_back(name);
+    }
+
+    std::string Cache::key ( const Request& request ) const
+    {
+        std::ostringstream key;
+        for ( size_t i = 0; (i < myVariables.size()); ++i )
+        {
+              // values may contain anything, prefix them with their size.
+            const std::string value = request.head().get(myVariables[i]);
+            key << value.size() << ':' << value;
+        }
+        return (key.str());
+    }
+
+    bool Cache::cacheable ( const Records& records )
+    {
+        const unsigned char *const data =
+            reinterpret_cast<const unsigned char*>(records.data());
+        std::string head;
+        size_t end = std::string::npos;
+        for ( size_t i = 0; (i+8 <= records.size()); )
+        {
+            const int type = data[i+1];
+            const size_t size = (data[i+4] << 8) | data[i+5];
+            const char *const content = records.data() + i + 8;
+              // collect standard output up to the end of the headers.
+            if ( (type == 6) && (end == std::string::npos) )
+            {
+                head.append(content, size);
+                end = head.find("\n\r\n");
+                if ( end == std::string::npos ) {
+                    end = head.find("\n\n");
+                }
+            }
+              // any application or protocol status is a failure.
+            if ( (type == 3) && (size >= 5) )
+            {
+                for ( size_t j = 0; (j < 5); ++j )
+                {
+                    if ( content[j] != 0 ) {
+                        return (false);
+                    }
+                }
+            }
+            i += 8 + size + data[i+6];
+        }
+        if ( end == std::string::npos ) {
+            return (false);
+        }
+        head.resize(end+1);
+        std::istringstream lines(head);
+        for ( std::string line; std::getline(lines, line); )
+        {
+            const std::string::size_type colon = line.find(':');
+            if ( colon == std::string::npos ) {
+                continue;
+            }
+            std::string name = line.substr(0, colon);
+            for ( size_t j = 0; (j < name.size()); ++j ) {
+                name[j] = char(std::tolower(
+                    static_cast<unsigned char>(name[j])));
+            }
+            const std::string value = line.substr(colon+1);
+            if ( (name == "status") && (std::atoi(value.c_str()) != 200) ) {
+                return (false);
+            }
+            if ( name == "set-cookie" ) {
+                return (false);
+            }
+            if ( (name == "cache-control") &&
+                 ((value.find("no-store") != std::string::npos) ||
+                  (value.find("private") != std::string::npos)) ) {
+                return (false);
+            }
+        }
+        return (true);
+    }
+
+    Cache::Status Cache::find
+        ( const std::string& key, const Records *& records )
+    {
+        const Entries::iterator match = myEntries.find(key);
+        if ( match == myEntries.end() ) {
+            return (miss);
+        }
+        Entry& entry = match->second;
+        const std::time_t now = std::time(0);
+        if ( now < entry.fresh ) {
+            records = &entry.records; return (hit);
+        }
+        if ( now < entry.stale )
+        {
+            records = &entry.records;
+              // let a single request regenerate the entry.
+            if ( entry.refreshing ) {
+                return (hit);
+            }
+            entry.refreshing = true;
+            return (refresh);
+        }
+        myEntries.erase(match);
+        return (miss);
+    }
+
+    void Cache::store ( const std::string& key, const Records& records )
+    {
+        Entries::iterator match = myEntries.find(key);
+        if ( match == myEntries.end() )
+        {
+            if ( myEntries.size() >= myLimit ) {
+                purge();
+            }
+            if ( myEntries.size() >= myLimit ) {
+                return;
+            }
+            match = myEntries.insert(std::make_pair(key, Entry())).first;
+        }
+        Entry& entry = match->second;
+        const std::time_t now = std::time(0);
+        entry.records = records;
+        entry.fresh = now + myTTL;
+        entry.stale = entry.fresh + myGrace;
+        entry.refreshing = false;
+    }
+
+    void Cache::abandon ( const std::string& key )
+    {
+        const Entries::iterator match = myEntries.find(key);
+        if ( match != myEntries.end() ) {
+            match->second.refreshing = false;
+        }
+    }
+
+    void Cache::purge ()
+    {
+        const std::time_t now = std::time(0);
+        Entries::iterator current = myEntries.begin();
+        while ( current != myEntries.end() )
+        {
+            if ( now >= current->second.stale ) {
+                myEntries.erase(current++);
+            }
+            else {
+                ++current;
+            }
+        }
+    }
+
+    size_t Cache::size () const
+    {
+        return (myEntries.size());
+    }
+
+}
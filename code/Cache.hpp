@@ -0,0 +1,153 @@
+#ifndef _fcgi_Cache_hpp__
+#define _fcgi_Cache_hpp__
+
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Cache.hpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include "Records.hpp"
+#include "Request.hpp"
+
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace fcgi {
+
+    /*!
+     * @group application
+     * @brief Short-lived store of complete responses.
+     *
+     * Responses are kept as pre-encoded records (see
+     * @c Application::capture()), keyed on selected CGI variables, and
+     * replayed with a single write.  Entries are fresh for @c ttl() seconds,
+     * then stale for @c grace() more seconds: the first lookup of a stale
+     * entry is asked to regenerate it while the others keep receiving the
+     * stale copy, so a burst of requests only runs the handler once.
+     *
+     * @see Responder::cache()
+     */
+    class Cache
+    {
+        /* nested types. */
+    public:
+        enum Status
+        {
+              //! no usable entry, run the handler and @c store() the result.
+            miss,
+              //! replay the entry.
+            hit,
+              //! replay the stale entry or run the handler, then @c store().
+            refresh,
+        };
+
+    private:
+        struct Entry
+        {
+            Records records;
+            std::time_t fresh;
+            std::time_t stale;
+            bool refreshing;
+        };
+
+        typedef std::map<std::string, Entry> Entries;
+
+        /* class data. */
+    public:
+        static const size_t DEFAULT_LIMIT = 1024;
+
+        /* data. */
+    private:
+        Entries myEntries;
+        std::vector<std::string> myVariables;
+        std::time_t myTTL;
+        std::time_t myGrace;
+        size_t myLimit;
+
+        /* construction. */
+    public:
+        /*!
+         * @param ttl Number of seconds responses are fresh.
+         * @param grace Number of seconds stale responses may still be served
+         *  while one request regenerates them.
+         * @param limit Maximum number of entries.
+         *
+         * Keys include @c REQUEST_METHOD, @c SERVER_NAME, @c HTTP_HOST,
+         * @c SCRIPT_NAME, @c PATH_INFO and @c QUERY_STRING, add more with
+         * @c vary().
+         */
+        explicit Cache ( std::time_t ttl, std::time_t grace=0,
+                         size_t limit=DEFAULT_LIMIT );
+
+        /* methods. */
+    public:
+        std::time_t ttl () const;
+        std::time_t grace () const;
+
+        /*!
+         * @brief Include CGI variable @a name (e.g. @c HTTP_ACCEPT_LANGUAGE)
+         *  in keys.
+         */
+        void vary ( const std::string& name );
+
+        /*!
+         * @brief Compute the key for @a request.
+         */
+        std::string key ( const Request& request ) const;
+
+        /*!
+         * @brief Look up a response.
+         * @param records Set to the entry on @c hit and @c refresh.
+         */
+        Status find ( const std::string& key, const Records *& records );
+
+        /*!
+         * @brief Store a fresh response.
+         *
+         * Expired entries are dropped to make room.  If the cache is still
+         * full, the response is not stored.
+         */
+        void store ( const std::string& key, const Records& records );
+
+        /*!
+         * @brief Give up on refreshing an entry, e.g. when the request was
+         *  aborted, so the next lookup tries again.
+         */
+        void abandon ( const std::string& key );
+
+        /*!
+         * @brief Drop expired entries.
+         */
+        void purge ();
+
+        /*!
+         * @brief Obtain the number of entries.
+         */
+        size_t size () const;
+
+        /* class methods. */
+    public:
+        /*!
+         * @brief Check if the response in @a records may be shared with
+         *  other clients.
+         *
+         * The request must end with statuses of 0, and the response must
+         * have a 200 status (explicit or not), no @c Set-Cookie header, and
+         * no @c Cache-Control header with @c private or @c no-store.
+         */
+        static bool cacheable ( const Records& records );
+    };
+
+}
+
+#endif /* _fcgi_Cache_hpp__ */
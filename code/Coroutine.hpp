@@ -0,0 +1,557 @@
+#ifndef _fcgi_Coroutine_hpp__
+#define _fcgi_Coroutine_hpp__
+
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Coroutine.hpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief Coroutine-based handlers (requires C++20).
+ *
+ * This header is empty unless the compiler supports coroutines, check
+ * @c FCGI_HAS_COROUTINES to find out.
+ */
+
+#include "Application.hpp"
+
+#if defined(__cpp_impl_coroutine) && (__cpp_impl_coroutine >= 201902L)
+#   define FCGI_HAS_COROUTINES 1
+
+#include <coroutine>
+#include <exception>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace fcgi {
+
+    template<typename T=void> class task;
+
+    namespace detail {
+
+        struct promise_base
+        {
+            // resumed when the coroutine completes (awaiting coroutine).
+            std::coroutine_handle<> myContinuation;
+            std::exception_ptr myError;
+
+            // invoked when a top-level coroutine completes.
+            void(*myDone)(void*);
+            void * myObject;
+
+            promise_base ()
+                : myDone(0), myObject(0)
+            {}
+
+            struct final_awaiter
+            {
+                bool await_ready () noexcept { return (false); }
+
+                template<typename P> std::coroutine_handle<>
+                    await_suspend ( std::coroutine_handle<P> self ) noexcept
+                {
+                    promise_base& promise = self.promise();
+                    if ( promise.myContinuation ) {
+                        return (promise.myContinuation);
+                    }
+                    if ( promise.myDone ) {
+                        promise.myDone(promise.myObject);
+                    }
+                    return (std::noop_coroutine());
+                }
+
+                void await_resume () noexcept {}
+            };
+
+            std::suspend_always initial_suspend () noexcept { return {}; }
+            final_awaiter final_suspend () noexcept { return {}; }
+
+            void unhandled_exception ()
+            {
+                myError = std::current_exception();
+            }
+        };
+
+        template<typename T>
+        struct promise :
+            public promise_base
+        {
+            T myValue;
+
+            task<T> get_return_object ();
+
+            void return_value ( T value )
+            {
+                myValue = std::move(value);
+            }
+        };
+
+        template<>
+        struct promise<void> :
+            public promise_base
+        {
+            task<void> get_return_object ();
+
+            void return_void () {}
+        };
+
+    }
+
+    /*!
+     * @group application
+     * @brief Lazily started coroutine, awaitable by other coroutines.
+     */
+    template<typename T>
+    class task
+    {
+        /* nested types. */
+    public:
+        typedef detail::promise<T> promise_type;
+        typedef std::coroutine_handle<promise_type> handle_type;
+
+        /* data. */
+    private:
+        handle_type myHandle;
+
+        /* construction. */
+    public:
+        task ()
+            : myHandle()
+        {}
+
+        explicit task ( handle_type handle )
+            : myHandle(handle)
+        {}
+
+        task ( task&& other ) noexcept
+            : myHandle(std::exchange(other.myHandle, {}))
+        {}
+
+        task& operator= ( task&& other ) noexcept
+        {
+            if ( myHandle ) {
+                myHandle.destroy();
+            }
+            myHandle = std::exchange(other.myHandle, {});
+            return (*this);
+        }
+
+        ~task ()
+        {
+            if ( myHandle ) {
+                myHandle.destroy();
+            }
+        }
+
+        task ( const task& ) = delete;
+        task& operator= ( const task& ) = delete;
+
+        /* methods. */
+    public:
+        handle_type handle () const
+        {
+            return (myHandle);
+        }
+
+        bool done () const
+        {
+            return (!myHandle || myHandle.done());
+        }
+
+        /* awaitable. */
+    public:
+        bool await_ready () const noexcept
+        {
+            return (done());
+        }
+
+        std::coroutine_handle<>
+            await_suspend ( std::coroutine_handle<> caller ) noexcept
+        {
+            myHandle.promise().myContinuation = caller;
+            return (myHandle);
+        }
+
+        T await_resume ()
+        {
+            promise_type& promise = myHandle.promise();
+            if ( promise.myError ) {
+                std::rethrow_exception(promise.myError);
+            }
+            if constexpr ( !std::is_void_v<T> ) {
+                return (std::move(promise.myValue));
+            }
+        }
+    };
+
+    namespace detail {
+
+        template<typename T>
+        task<T> promise<T>::get_return_object ()
+        {
+            return (task<T>(
+                std::coroutine_handle< promise<T> >::from_promise(*this)));
+        }
+
+        inline task<void> promise<void>::get_return_object ()
+        {
+            return (task<void>(
+                std::coroutine_handle< promise<void> >::from_promise(*this)));
+        }
+
+    }
+
+    /*!
+     * @group application
+     * @brief Decides where suspended handlers are resumed.
+     *
+     * The default scheduler resumes them immediately, on the thread that
+     * delivers the event (request body, drained output).
+     */
+    class Scheduler
+    {
+    public:
+        virtual ~Scheduler () {}
+
+        virtual void post ( std::coroutine_handle<> handle )
+        {
+            handle.resume();
+        }
+    };
+
+    class AsyncApplication;
+
+    /*!
+     * @group application
+     * @brief A request, as seen by a coroutine handler.
+     */
+    class Exchange
+    {
+        friend class AsyncApplication;
+
+        /* data. */
+    private:
+        AsyncApplication& myApplication;
+        Request * myRequest;
+        task<> myHandler;
+
+          // body content received, but not read yet.
+        std::string myPending;
+        std::string myCurrent;
+        bool myComplete;
+        bool myAborted;
+
+          // suspended reader/writer.
+        std::coroutine_handle<> myReader;
+        std::coroutine_handle<> myWriter;
+
+        /* construction. */
+    private:
+        Exchange ( AsyncApplication& application, Request& request )
+            : myApplication(application), myRequest(&request),
+              myComplete(false), myAborted(false)
+        {}
+
+        /* methods. */
+    public:
+        /*!
+         * @brief Access the request.
+         *
+         * Only valid until @c end() or until the request is aborted.
+         */
+        Request& request () const
+        {
+            return (*myRequest);
+        }
+
+        /*!
+         * @brief Check if the gateway aborted the request.
+         */
+        bool aborted () const
+        {
+            return (myAborted);
+        }
+
+        /*!
+         * @brief Wait for the next chunk of the request body.
+         *
+         * @code
+         *  for ( std::string_view chunk;
+         *        !(chunk=co_await exchange.read()).empty(); ) {
+         *      // ...
+         *  }
+         * @endcode
+         *
+         * The chunk is valid until the next call.  An empty chunk signals the
+         * end of the body (or that the request was aborted).
+         */
+        auto read ()
+        {
+            struct awaiter
+            {
+                Exchange& myExchange;
+
+                bool await_ready () const noexcept
+                {
+                    return (!myExchange.myPending.empty() ||
+                            myExchange.myComplete || myExchange.myAborted);
+                }
+
+                void await_suspend ( std::coroutine_handle<> handle ) noexcept
+                {
+                    myExchange.myReader = handle;
+                }
+
+                std::string_view await_resume ()
+                {
+                    myExchange.myCurrent.clear();
+                    myExchange.myCurrent.swap(myExchange.myPending);
+                    return (myExchange.myCurrent);
+                }
+            };
+            return (awaiter{*this});
+        }
+
+        /*!
+         * @brief Send output, waiting while too much output is pending.
+         * @return @c false if the request was aborted.
+         */
+        auto write ( std::string_view data );
+
+        /*!
+         * @brief Send the end of the output and end the request.
+         */
+        void end ( uint32_t astatus=0 );
+    };
+
+    /*!
+     * @group application
+     * @brief Application whose requests are handled by coroutines.
+     *
+     * @c handle() starts once a request's headers are received, and the
+     * request ends when it completes (unless it called @c Exchange::end()).
+     * Body content is delivered to @c Exchange::read() as it arrives, and
+     * @c Exchange::write() suspends the handler instead of queueing output
+     * without bounds.  A single thread can serve many slow requests at once.
+     */
+    class AsyncApplication :
+        public Application
+    {
+        friend class Exchange;
+
+        /* data. */
+    private:
+          // exchanges by live request, and all running handlers.
+        std::map<Request*, Exchange*> myExchanges;
+        std::set<Exchange*> myHandlers;
+        Scheduler myInline;
+        Scheduler * myScheduler;
+        size_t myHighwater;
+
+        /* construction. */
+    public:
+        AsyncApplication ()
+            : myScheduler(&myInline), myHighwater(64*1024)
+        {}
+
+        virtual ~AsyncApplication ()
+        {
+            std::set<Exchange*>::iterator current = myHandlers.begin();
+            for ( ; (current != myHandlers.end()); ++current ) {
+                delete *current;
+            }
+        }
+
+        /* methods. */
+    public:
+        /*!
+         * @brief Resume handlers through @a scheduler.
+         */
+        void scheduler ( Scheduler& scheduler )
+        {
+            myScheduler = &scheduler;
+        }
+
+        /*!
+         * @brief Suspend writers while more than @a size bytes are pending.
+         */
+        void highwater ( size_t size )
+        {
+            myHighwater = size;
+        }
+
+        /* contract. */
+    protected:
+        /*!
+         * @brief Handle a request.
+         */
+        virtual task<> handle ( Exchange& exchange ) = 0;
+
+        /* overrides. */
+    protected:
+        virtual void end_of_head ( Request& request )
+        {
+            Exchange *const exchange = new Exchange(*this, request);
+            myExchanges[&request] = exchange;
+            myHandlers.insert(exchange);
+            exchange->myHandler = handle(*exchange);
+            task<>::promise_type& promise =
+                exchange->myHandler.handle().promise();
+            promise.myDone = &AsyncApplication::finished;
+            promise.myObject = exchange;
+            myScheduler->post(exchange->myHandler.handle());
+        }
+
+        virtual void body ( Request& request, const char * data, size_t size )
+        {
+            Exchange *const exchange = find(request);
+            if ( exchange == 0 ) {
+                return;
+            }
+            exchange->myPending.append(data, size);
+            wake(exchange->myReader);
+        }
+
+        virtual void end_of_body ( Request& request )
+        {
+            Exchange *const exchange = find(request);
+            if ( exchange == 0 ) {
+                return;
+            }
+            exchange->myComplete = true;
+            wake(exchange->myReader);
+        }
+
+        virtual void abort ( Request& request )
+        {
+            Exchange *const exchange = find(request);
+            if ( exchange == 0 ) {
+                return;
+            }
+              // the request is recycled when this returns.
+            exchange->myAborted = true;
+            detach(*exchange);
+            wake(exchange->myReader);
+            wake(exchange->myWriter);
+        }
+
+        virtual void drained ()
+        {
+              // copy: resumed writers may end their request.
+            std::map<Request*, Exchange*> exchanges(myExchanges);
+            std::map<Request*, Exchange*>::iterator current =
+                exchanges.begin();
+            for ( ; (current != exchanges.end()); ++current ) {
+                wake(current->second->myWriter);
+            }
+        }
+
+        /* implementation. */
+    private:
+        Exchange * find ( Request& request )
+        {
+            std::map<Request*, Exchange*>::iterator match =
+                myExchanges.find(&request);
+            if ( match == myExchanges.end() ) {
+                return (0);
+            }
+            return (match->second);
+        }
+
+        void wake ( std::coroutine_handle<>& handle )
+        {
+            if ( handle ) {
+                myScheduler->post(std::exchange(handle, {}));
+            }
+        }
+
+        void detach ( Exchange& exchange )
+        {
+            if ( exchange.myRequest == 0 ) {
+                return;
+            }
+            std::map<Request*, Exchange*>::iterator match =
+                myExchanges.find(exchange.myRequest);
+            if ( (match != myExchanges.end()) &&
+                 (match->second == &exchange) )
+            {
+                myExchanges.erase(match);
+            }
+            exchange.myRequest = 0;
+        }
+
+        static void finished ( void * object )
+        {
+            Exchange *const exchange = static_cast<Exchange*>(object);
+            AsyncApplication& application = exchange->myApplication;
+            if ( exchange->myRequest != 0 )
+            {
+                Request& request = *exchange->myRequest;
+                std::exception_ptr error =
+                    exchange->myHandler.handle().promise().myError;
+                if ( error ) {
+                    application.errors(request, "Handler failed.");
+                    application.errors(request);
+                }
+                application.output(request);
+                application.end_request(request, error? 1 : 0);
+            }
+            application.detach(*exchange);
+            application.myHandlers.erase(exchange);
+              // the coroutine is suspended at its final suspend point.
+            delete exchange;
+        }
+    };
+
+    inline auto Exchange::write ( std::string_view data )
+    {
+        if ( (myRequest != 0) && !myAborted ) {
+            myApplication.output(*myRequest, std::string(data));
+        }
+        struct awaiter
+        {
+            Exchange& myExchange;
+
+            bool await_ready () const noexcept
+            {
+                return (myExchange.myAborted || (myExchange.myRequest == 0) ||
+                        (myExchange.myApplication.pending()
+                         <= myExchange.myApplication.myHighwater));
+            }
+
+            void await_suspend ( std::coroutine_handle<> handle ) noexcept
+            {
+                myExchange.myWriter = handle;
+            }
+
+            bool await_resume () const noexcept
+            {
+                return (!myExchange.myAborted);
+            }
+        };
+        return (awaiter{*this});
+    }
+
+    inline void Exchange::end ( uint32_t astatus )
+    {
+        if ( (myRequest == 0) || myAborted ) {
+            return;
+        }
+        Request& request = *myRequest;
+        myApplication.detach(*this);
+        myApplication.output(request);
+        myApplication.end_request(request, astatus);
+    }
+
+}
+
+#endif
+
+#endif /* _fcgi_Coroutine_hpp__ */
@@ -0,0 +1,336 @@
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Executor.cpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief Off-loading of handler work to other threads.
+ */
+
+#include "Executor.hpp"
+
+#include <chrono>
+#include <cmath>
+
+namespace fcgi {
+
+    Job::Job ()
+        : myNext(0), myCompletions(0), myPriority(0), myDeadline(0.0),
+          myExpired(false), myStarted(0.0)
+    {
+    }
+
+    Job::~Job ()
+    {
+    }
+
+    void Job::finish ()
+    {
+        if ( myCompletions == 0 ) {
+            delete this; return;
+        }
+        myCompletions->post(this);
+    }
+
+    void Job::run ()
+    {
+        myStarted = now();
+          // don't waste time on results nobody waits for.
+        if ( (myDeadline != 0.0) && (myStarted > myDeadline) ) {
+            expire(); return;
+        }
+        execute();
+    }
+
+    double Job::started () const
+    {
+        return (myStarted);
+    }
+
+    int Job::priority () const
+    {
+        return (myPriority);
+    }
+
+    void Job::priority ( int priority )
+    {
+        myPriority = priority;
+    }
+
+    double Job::deadline () const
+    {
+        return (myDeadline);
+    }
+
+    void Job::deadline ( double deadline )
+    {
+          // NaN would break the strict weak ordering of PriorityPool.
+        myDeadline = (std::isfinite(deadline) && (deadline > 0.0))?
+            deadline : 0.0;
+    }
+
+    void Job::expire ()
+    {
+        myExpired = true;
+    }
+
+    bool Job::expired () const
+    {
+        return (myExpired);
+    }
+
+    double Job::now ()
+    {
+        const std::chrono::duration<double> time =
+            std::chrono::system_clock::now().time_since_epoch();
+        return (time.count());
+    }
+
+    ThreadPool::ThreadPool ( size_t threads )
+        : myNext(0), myPending(0), myStopping(false)
+    {
+        if ( threads == 0 ) {
+            threads = std::thread::hardware_concurrency();
+        }
+        if ( threads == 0 ) {
+            threads = 1;
+        }
+        for ( size_t i = 0; (i < threads); ++i ) {
+            myQueues.push_back(new Queue());
+        }
+        for ( size_t i = 0; (i < threads); ++i ) {
+            myThreads.push_back(std::thread(&ThreadPool::work, this, i));
+        }
+    }
+
+    ThreadPool::~ThreadPool ()
+    {
+        { std::lock_guard<std::mutex> _(myLock);
+            myStopping = true;
+        }
+        myReady.notify_all();
+        for ( size_t i = 0; (i < myThreads.size()); ++i ) {
+            myThreads[i].join();
+        }
+        for ( size_t i = 0; (i < myQueues.size()); ++i ) {
+            delete myQueues[i];
+        }
+    }
+
+    size_t ThreadPool::threads () const
+    {
+        return (myThreads.size());
+    }
+
+    void ThreadPool::submit ( Job * job )
+    {
+          // spread jobs over the queues, idle threads steal the excess.
+        Queue& queue = *myQueues[myNext++ % myQueues.size()];
+        { std::lock_guard<std::mutex> _(queue.lock);
+            queue.jobs.push_back(job);
+        }
+        { std::lock_guard<std::mutex> _(myLock);
+            ++myPending;
+        }
+        myReady.notify_one();
+    }
+
+    Job * ThreadPool::take ( size_t queue )
+    {
+        Job * job = 0;
+          // own queue first, oldest job first.
+        for ( size_t i = 0; (i < myQueues.size()) && (job == 0); ++i )
+        {
+            Queue& victim = *myQueues[(queue+i) % myQueues.size()];
+            std::lock_guard<std::mutex> _(victim.lock);
+            if ( victim.jobs.empty() ) {
+                continue;
+            }
+              // steal from the other end, away from the owner.
+            if ( i == 0 ) {
+                job = victim.jobs.front(); victim.jobs.pop_front();
+            }
+            else {
+                job = victim.jobs.back(); victim.jobs.pop_back();
+            }
+        }
+        return (job);
+    }
+
+    void ThreadPool::work ( size_t queue )
+    {
+        while ( true )
+        {
+            { std::unique_lock<std::mutex> lock(myLock);
+                while ( (myPending == 0) && !myStopping ) {
+                    myReady.wait(lock);
+                }
+                if ( myPending == 0 ) {
+                    return;
+                }
+                --myPending;
+            }
+              // a job is reserved for us, but maybe in another queue.
+            Job * job = 0;
+            while ( job == 0 ) {
+                job = take(queue);
+            }
+            job->run();
+            job->finish();
+        }
+    }
+
+    bool PriorityPool::Entry::operator< ( const Entry& other ) const
+    {
+          // std::priority_queue runs the *largest* entry first.
+        if ( job->priority() != other.job->priority() ) {
+            return (job->priority() < other.job->priority());
+        }
+        const double lhs = job->deadline();
+        const double rhs = other.job->deadline();
+        if ( lhs != rhs )
+        {
+              // no deadline sorts last.
+            if ( lhs == 0.0 ) {
+                return (true);
+            }
+            if ( rhs == 0.0 ) {
+                return (false);
+            }
+            return (lhs > rhs);
+        }
+        return (sequence > other.sequence);
+    }
+
+    PriorityPool::PriorityPool ( size_t threads )
+        : mySequence(0), myStopping(false)
+    {
+        if ( threads == 0 ) {
+            threads = std::thread::hardware_concurrency();
+        }
+        if ( threads == 0 ) {
+            threads = 1;
+        }
+        for ( size_t i = 0; (i < threads); ++i ) {
+            myThreads.push_back(std::thread(&PriorityPool::work, this));
+        }
+    }
+
+    PriorityPool::~PriorityPool ()
+    {
+        { std::lock_guard<std::mutex> _(myLock);
+            myStopping = true;
+        }
+        myReady.notify_all();
+        for ( size_t i = 0; (i < myThreads.size()); ++i ) {
+            myThreads[i].join();
+        }
+    }
+
+    size_t PriorityPool::threads () const
+    {
+        return (myThreads.size());
+    }
+
+    void PriorityPool::submit ( Job * job )
+    {
+        { std::lock_guard<std::mutex> _(myLock);
+            const Entry entry = { job, mySequence++ };
+            myJobs.push(entry);
+        }
+        myReady.notify_one();
+    }
+
+    void PriorityPool::work ()
+    {
+        while ( true )
+        {
+            Job * job = 0;
+            { std::unique_lock<std::mutex> lock(myLock);
+                while ( myJobs.empty() && !myStopping ) {
+                    myReady.wait(lock);
+                }
+                if ( myJobs.empty() ) {
+                    return;
+                }
+                job = myJobs.top().job; myJobs.pop();
+            }
+            job->run();
+            job->finish();
+        }
+    }
+
+    Completions::Completions ( void(*notify)(void*), void * object )
+        : myHead(&myStub), myTail(&myStub), myOutstanding(0), myPosting(0),
+          myNotify(notify), myObject(object)
+    {
+    }
+
+    Completions::~Completions ()
+    {
+    }
+
+    void Completions::expect ( Job * job )
+    {
+        job->myCompletions = this;
+        ++myOutstanding;
+    }
+
+    void Completions::post ( Job * job )
+    {
+        ++myPosting;
+        push(job);
+        if ( myNotify ) {
+            myNotify(myObject);
+        }
+        --myPosting;
+    }
+
+    void Completions::push ( Job * job )
+    {
+        job->myNext.store(0, std::memory_order_relaxed);
+        Job *const prev = myHead.exchange(job, std::memory_order_acq_rel);
+        prev->myNext.store(job, std::memory_order_release);
+    }
+
+    Job * Completions::take ()
+    {
+        Job * tail = myTail;
+        Job * next = tail->myNext.load(std::memory_order_acquire);
+          // skip the stub node.
+        if ( tail == &myStub )
+        {
+            if ( next == 0 ) {
+                return (0);
+            }
+            myTail = tail = next;
+            next = next->myNext.load(std::memory_order_acquire);
+        }
+        if ( next == 0 )
+        {
+              // a producer is between its exchange and its store.
+            if ( tail != myHead.load(std::memory_order_acquire) ) {
+                return (0);
+            }
+              // last node: put the stub back so that it can be detached.
+            push(&myStub);
+            next = tail->myNext.load(std::memory_order_acquire);
+            if ( next == 0 ) {
+                return (0);
+            }
+        }
+        myTail = next;
+        --myOutstanding;
+        return (tail);
+    }
+
+    size_t Completions::outstanding () const
+    {
+        return (myOutstanding.load() + myPosting.load());
+    }
+
+}
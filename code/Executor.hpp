@@ -0,0 +1,361 @@
+#ifndef _fcgi_Executor_hpp__
+#define _fcgi_Executor_hpp__
+
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Executor.hpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief Off-loading of handler work to other threads.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace fcgi {
+
+    class Completions;
+    class Request;
+
+    /*!
+     * @group application
+     * @brief Unit of handler work that runs off the I/O thread.
+     *
+     * @c execute() runs on an executor thread and must not use the
+     * application's output methods.  @c complete() runs later on the
+     * connection's I/O thread, where it may send output and end requests.
+     */
+    class Job
+    {
+        /* nested types. */
+    private:
+          // request the job runs for, see Request.
+        struct Member
+        {
+            unsigned short id;
+            unsigned long generation;
+            double arrival;
+        };
+
+        /* data. */
+    private:
+        std::atomic<Job*> myNext;
+        Completions * myCompletions;
+
+          // scheduling, see Application::dispatch().
+        int myPriority;
+        double myDeadline;
+        bool myExpired;
+        std::vector<Member> myMembers;
+        double myStarted;
+
+        /* construction. */
+    public:
+        Job ();
+        virtual ~Job ();
+
+    private:
+        Job ( const Job& );
+        Job& operator= ( const Job& );
+
+        /* methods. */
+    public:
+        /*!
+         * @brief Do the work, on an executor thread.
+         */
+        virtual void execute () = 0;
+
+        /*!
+         * @brief Use the results, on the I/O thread.
+         */
+        virtual void complete () = 0;
+
+        /*!
+         * @brief Start the job, on an executor thread.
+         *
+         * Executors call this rather than @c execute(): it records the start
+         * time and calls @c expire() instead if the deadline passed.
+         */
+        void run ();
+
+        /*!
+         * @brief Obtain the time @c run() was called, see @c now().
+         */
+        double started () const;
+
+        /*!
+         * @brief Hand the job back to its connection after @c execute().
+         *
+         * Jobs that were not dispatched by an application are deleted.
+         */
+        void finish ();
+
+        /*!
+         * @brief Obtain the job's priority, higher runs first.
+         */
+        int priority () const;
+        void priority ( int priority );
+
+        /*!
+         * @brief Obtain the time past which the job is useless, see
+         *  @c now().  Zero (the default) means no deadline, and so do
+         *  negative and non-finite values.
+         */
+        double deadline () const;
+        void deadline ( double deadline );
+
+        /*!
+         * @brief Skip the job, because its deadline passed.
+         */
+        void expire ();
+
+        /*!
+         * @brief Check if @c expire() was called.
+         */
+        bool expired () const;
+
+        /* class methods. */
+    public:
+        /*!
+         * @brief Obtain the current time, in seconds since the Unix epoch.
+         */
+        static double now ();
+
+        friend class Application;
+        friend class Completions;
+    };
+
+    /*!
+     * @group application
+     * @brief Runs jobs on some set of threads.
+     */
+    class Executor
+    {
+        /* construction. */
+    public:
+        virtual ~Executor () {}
+
+        /* methods. */
+    public:
+        /*!
+         * @brief Queue @a job, call its @c execute() then its @c finish().
+         */
+        virtual void submit ( Job * job ) = 0;
+    };
+
+    /*!
+     * @group application
+     * @brief Fixed-size pool of threads that steal work from each other.
+     *
+     * Each thread has its own queue.  Jobs are spread over the queues, and a
+     * thread whose queue is empty takes jobs from the other queues before
+     * going to sleep.
+     */
+    class ThreadPool :
+        public Executor
+    {
+        /* nested types. */
+    private:
+        struct Queue
+        {
+            std::mutex lock;
+            std::deque<Job*> jobs;
+        };
+
+        /* data. */
+    private:
+        std::vector<Queue*> myQueues;
+        std::vector<std::thread> myThreads;
+        std::atomic<size_t> myNext;
+
+          // sleeping threads wait for work here.
+        std::mutex myLock;
+        std::condition_variable myReady;
+        size_t myPending;
+        bool myStopping;
+
+        /* construction. */
+    public:
+        /*!
+         * @brief Start @a threads threads (defaults to one per core).
+         */
+        explicit ThreadPool ( size_t threads=0 );
+
+        /*!
+         * @brief Run all queued jobs, then stop the threads.
+         */
+        virtual ~ThreadPool ();
+
+    private:
+        ThreadPool ( const ThreadPool& );
+        ThreadPool& operator= ( const ThreadPool& );
+
+        /* methods. */
+    public:
+        size_t threads () const;
+
+        virtual void submit ( Job * job );
+
+    private:
+        Job * take ( size_t queue );
+        void work ( size_t queue );
+    };
+
+    /*!
+     * @group application
+     * @brief Pool of threads that run the most urgent jobs first.
+     *
+     * Jobs run by decreasing @c Job::priority(), then by earliest
+     * @c Job::deadline() (jobs without a deadline last), then in submission
+     * order.
+     */
+    class PriorityPool :
+        public Executor
+    {
+        /* nested types. */
+    private:
+        struct Entry
+        {
+            Job * job;
+            unsigned long long sequence;
+
+            bool operator< ( const Entry& other ) const;
+        };
+
+        /* data. */
+    private:
+        std::vector<std::thread> myThreads;
+
+        std::mutex myLock;
+        std::condition_variable myReady;
+        std::priority_queue<Entry> myJobs;
+        unsigned long long mySequence;
+        bool myStopping;
+
+        /* construction. */
+    public:
+        /*!
+         * @brief Start @a threads threads (defaults to one per core).
+         */
+        explicit PriorityPool ( size_t threads=0 );
+
+        /*!
+         * @brief Run all queued jobs, then stop the threads.
+         */
+        virtual ~PriorityPool ();
+
+    private:
+        PriorityPool ( const PriorityPool& );
+        PriorityPool& operator= ( const PriorityPool& );
+
+        /* methods. */
+    public:
+        size_t threads () const;
+
+        virtual void submit ( Job * job );
+
+    private:
+        void work ();
+    };
+
+    /*!
+     * @group application
+     * @brief Lock-free queue of jobs waiting for @c Job::complete().
+     *
+     * Any number of executor threads post to the queue, a single I/O thread
+     * collects from it.
+     */
+    class Completions
+    {
+        /* nested types. */
+    private:
+        class Stub :
+            public Job
+        {
+        public:
+            virtual void execute () {}
+            virtual void complete () {}
+        };
+
+        /* data. */
+    private:
+        std::atomic<Job*> myHead;
+        Job * myTail;
+        Stub myStub;
+
+          // jobs dispatched, but not collected yet.
+        std::atomic<size_t> myOutstanding;
+
+          // calls to post() in progress, which still use myObject.
+        std::atomic<size_t> myPosting;
+
+          // wakes up the I/O thread.
+        void(*myNotify)(void*);
+        void * myObject;
+
+        /* construction. */
+    public:
+        /*!
+         * @brief Create an empty queue.
+         * @param notify Callback invoked (from executor threads) with
+         *  @a object each time a job is posted.
+         */
+        Completions ( void(*notify)(void*), void * object );
+
+        /*!
+         * @brief Destroy the queue, which must have no @c outstanding() jobs.
+         *
+         * Executor threads use the queue and the notification object until
+         * @c outstanding() is 0, so the owner must collect all jobs first.
+         */
+        ~Completions ();
+
+    private:
+        Completions ( const Completions& );
+        Completions& operator= ( const Completions& );
+
+        /* methods. */
+    public:
+        /*!
+         * @brief Register @a job as outstanding, it will be posted later.
+         */
+        void expect ( Job * job );
+
+        /*!
+         * @brief Queue @a job for completion, from any thread.
+         */
+        void post ( Job * job );
+
+        /*!
+         * @brief Dequeue a job, from the I/O thread.
+         * @return The job, or 0 if there is none.
+         */
+        Job * take ();
+
+        /*!
+         * @brief Obtain the number of jobs dispatched but not collected.
+         *
+         * Jobs collected while their executor thread is still notifying the
+         * I/O thread count until the notification returns, so the object
+         * passed to the constructor may be destroyed once this is 0.
+         */
+        size_t outstanding () const;
+
+    private:
+        void push ( Job * job );
+    };
+
+}
+
+#endif /* _fcgi_Executor_hpp__ */
@@ -0,0 +1,66 @@
+#ifndef _fcgi_Filter_hpp__
+#define _fcgi_Filter_hpp__
+
+// Copyright(c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Filter.hpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include "Application.hpp"
+
+namespace fcgi {
+
+    /*!
+     * @brief Transforms a file sent by the gateway.
+     *
+     * The file arrives in the @c FCGI_DATA stream, after the request body.
+     * By default, it is collected in @c Request::data() (or
+     * @c Request::data_spool()) and @c handle_filter() is called when it is
+     * complete.  To transform the file as a stream instead, override
+     * @c data(Request&,const char*,size_t) and send output from there.
+     */
+    class Filter :
+        public Application
+    {
+        /* contract. */
+    protected:
+        /*!
+         * @brief Handle filter request, once the file was received.
+         */
+        virtual void handle_filter (fcgi::Request& request) = 0;
+
+        /* overrides. */
+    protected:
+        virtual void end_of_head (fcgi::Request& request)
+        {
+            // Only handle filter requests.
+            if (request.role() != fcgi::Role::filter())
+            {
+                errors(request,
+                    "This is a filter, not a responder or authorizer."
+                );
+                errors(request);
+                output(request);
+                end_request(request, 1);
+            }
+        }
+
+        virtual void end_of_body (fcgi::Request&) {}
+
+        virtual void end_of_data (fcgi::Request& request)
+        {
+            handle_filter(request);
+        }
+    };
+
+}
+
+#endif /* _fcgi_Filter_hpp__ */
@@ -0,0 +1,121 @@
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Flights.cpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include "Flights.hpp"
+
+namespace fcgi {
+
+    Flights::Flights ()
+    {
+    }
+
+    bool Flights::join ( Application& application,
+                         Request& request, const std::string& key )
+    {
+        const std::pair<Groups::iterator, bool> group =
+            myGroups.insert(std::make_pair(key, std::vector<Member>()));
+        const Member member = { &application, &request };
+        group.first->second.push_back(member);
+        myMembers[&request] = group.first;
+        return (!group.second);
+    }
+
+    bool Flights::joined ( const Request& request ) const
+    {
+        return (myMembers.count(&request) > 0);
+    }
+
+    bool Flights::waiting ( const Request& request ) const
+    {
+        const std::map<const Request*, Groups::iterator>::const_iterator
+            match = myMembers.find(&request);
+        return ((match != myMembers.end()) &&
+                (match->second->second.front().request != &request));
+    }
+
+    bool Flights::leads ( const Request& request ) const
+    {
+        const std::map<const Request*, Groups::iterator>::const_iterator
+            match = myMembers.find(&request);
+        return ((match != myMembers.end()) &&
+                (match->second->second.front().request == &request));
+    }
+
+    Flights::Member Flights::leave ( const Request& request )
+    {
+        const Member none = { 0, 0 };
+        const std::map<const Request*, Groups::iterator>::iterator
+            match = myMembers.find(&request);
+        if ( match == myMembers.end() ) {
+            return (none);
+        }
+        const Groups::iterator group = match->second;
+        myMembers.erase(match);
+        std::vector<Member>& members = group->second;
+        const bool leader = (members.front().request == &request);
+        for ( size_t i = 0; (i < members.size()); ++i )
+        {
+            if ( members[i].request == &request ) {
+                members.erase(members.begin()+i); break;
+            }
+        }
+        if ( members.empty() ) {
+            myGroups.erase(group); return (none);
+        }
+        return (leader? members.front() : none);
+    }
+
+    std::vector<Flights::Member> Flights::land ( const Request& request )
+    {
+        std::vector<Member> waiters;
+        const std::map<const Request*, Groups::iterator>::iterator
+            match = myMembers.find(&request);
+        if ( match == myMembers.end() ) {
+            return (waiters);
+        }
+        const Groups::iterator group = match->second;
+        waiters.assign(group->second.begin()+1, group->second.end());
+        for ( size_t i = 0; (i < group->second.size()); ++i ) {
+            myMembers.erase(group->second[i].request);
+        }
+        myGroups.erase(group);
+        return (waiters);
+    }
+
+    std::vector<Request*> Flights::members
+        ( const Application& application ) const
+    {
+        std::vector<Request*> waiters;
+        std::vector<Request*> leaders;
+        Groups::const_iterator group = myGroups.begin();
+        for ( ; (group != myGroups.end()); ++group )
+        {
+            const std::vector<Member>& members = group->second;
+            for ( size_t i = 0; (i < members.size()); ++i )
+            {
+                if ( members[i].application != &application ) {
+                    continue;
+                }
+                ((i == 0)? leaders : waiters).push_back(members[i].request);
+            }
+        }
+        waiters.insert(waiters.end(), leaders.begin(), leaders.end());
+        return (waiters);
+    }
+
+    bool Flights::empty () const
+    {
+        return (myMembers.empty());
+    }
+
+}
@@ -0,0 +1,116 @@
+#ifndef _fcgi_Flights_hpp__
+#define _fcgi_Flights_hpp__
+
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Flights.hpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace fcgi {
+
+    class Application;
+    class Request;
+
+    /*!
+     * @group application
+     * @brief Groups of identical in-flight requests, see
+     *  @c Application::coalesce().
+     *
+     * Each application has its own groups, which only see requests of its
+     * connection.  Gateways that send one request per connection (most of
+     * them) never multiplex identical requests, so share one object between
+     * the applications of all connections served by the same thread, see
+     * @c Application::flights().  The object is not thread-safe.
+     */
+    class Flights
+    {
+        /* nested types. */
+    public:
+        struct Member
+        {
+            Application * application;
+            Request * request;
+        };
+
+    private:
+          // members by key, the leader first.
+        typedef std::map<std::string, std::vector<Member> > Groups;
+
+        /* data. */
+    private:
+        Groups myGroups;
+        std::map<const Request*, Groups::iterator> myMembers;
+
+        /* construction. */
+    public:
+        Flights ();
+
+    private:
+        Flights ( const Flights& );
+        Flights& operator= ( const Flights& );
+
+        /* methods. */
+    public:
+        /*!
+         * @brief Add @a request to the group for @a key.
+         * @return @c true if @a request waits on the group's leader, @c false
+         *  if it leads a new group.
+         */
+        bool join ( Application& application,
+                    Request& request, const std::string& key );
+
+        /*!
+         * @brief Check if @a request belongs to a group.
+         */
+        bool joined ( const Request& request ) const;
+
+        /*!
+         * @brief Check if @a request belongs to a group it does not lead.
+         */
+        bool waiting ( const Request& request ) const;
+
+        /*!
+         * @brief Check if @a request leads a group.
+         */
+        bool leads ( const Request& request ) const;
+
+        /*!
+         * @brief Remove @a request from its group.
+         * @return The group's new leader, if @a request led the group and
+         *  other requests wait on it.  Otherwise, a member with null
+         *  pointers.
+         */
+        Member leave ( const Request& request );
+
+        /*!
+         * @brief Remove the group led by @a request.
+         * @return The requests that waited on @a request.
+         */
+        std::vector<Member> land ( const Request& request );
+
+        /*!
+         * @brief Obtain the requests of @a application, waiters first.
+         */
+        std::vector<Request*> members ( const Application& application ) const;
+
+        /*!
+         * @brief Check if no request belongs to a group.
+         */
+        bool empty () const;
+    };
+
+}
+
+#endif /* _fcgi_Flights_hpp__ */
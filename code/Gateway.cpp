@@ -12,13 +12,19 @@
  */
 
 #include "Gateway.hpp"
-#include <sstream>
+#include <algorithm>
 #include <stdexcept>
 
+namespace {
+
+    const size_t MAXIMUM_CONTENT_LENGTH = (1 << 16)-1;
+
+}
+
 namespace fcgi {
 
     Gateway::Gateway ()
-        : myResponses(), mySelection(myResponses.end())
+        : myResponses(), mySelection(myResponses.end()), myRecord(0)
     {
         ::fcgi_iwire_init(&myISettings, &myIWire);
         myIWire.object = static_cast<void*>(this);
@@ -38,6 +44,11 @@ namespace fcgi {
         myOWire.write_stream = &Gateway::write_stream;
     }
 
+    Gateway::~Gateway ()
+    {
+        ::fcgi_owire_clear(&myOWire);
+    }
+
     void Gateway::gfeed ( const char * data, size_t size )
     {
         ::fcgi_iwire_feed(&myIWire, data, size);
@@ -48,15 +59,24 @@ namespace fcgi {
         ::fcgi_iwire_feed(&myIWire, buffer.data(), buffer.size());
     }
 
+    size_t Gateway::pending () const
+    {
+        return (::fcgi_owire_pending(&myOWire));
+    }
+
+    size_t Gateway::resume ()
+    {
+        return (::fcgi_owire_resume(&myOWire));
+    }
+
+    bool Gateway::more () const
+    {
+        return (myOWire.more != 0);
+    }
+
     void Gateway::query ( const std::string& name )
     {
-          // build the reply (name,value) pair.
-        std::ostringstream stream;
-        stream
-            << (char)name.size() << (char)0 << name << "";
-        const std::string query = stream.str();
-          // send it.
-        ::fcgi_owire_query(&myOWire, query.data(), query.size());
+        ::fcgi_owire_query_pair(&myOWire, name.data(), name.size());
     }
 
     void Gateway::new_request ( uint16_t request )
@@ -87,13 +107,15 @@ namespace fcgi {
             return;
         }
         Response& response = mySelection->second;
-          // build the reply (name,value) pair.
-        std::ostringstream stream;
-        stream
-            << (char)name.size() << (char)data.size() << name << data;
-        const std::string param = stream.str();
-          // send it.
-        ::fcgi_owire_param(&myOWire, response.id(), param.data(), param.size());
+          // encode the (name,value) pair straight to the wire.
+        ::fcgi_owire_param_pair(&myOWire, response.id(),
+            name.data(), name.size(), data.data(), data.size());
+    }
+
+    void Gateway::head ( const char * name, const char * data )
+    {
+          // don't confuse string literals with an iterator range.
+        head(std::string(name), std::string(data));
     }
 
     void Gateway::head ()
@@ -107,6 +129,28 @@ namespace fcgi {
         ::fcgi_owire_param(&myOWire, response.id(), 0, 0);
     }
 
+    void Gateway::head ( const Headers& headers )
+    {
+          // read headers in place, without copying them.
+        head(headers.begin().base(), headers.end().base());
+    }
+
+    void Gateway::head ( const ParamTemplate& prefix )
+    {
+          // locate the request.
+        if ( mySelection == myResponses.end() ) {
+            return;
+        }
+        open_params();
+        pack_param(prefix.data(), prefix.size());
+        close_params();
+    }
+
+    void Gateway::head ( const ParamTemplate& prefix, const Headers& headers )
+    {
+        head(prefix, headers.begin().base(), headers.end().base());
+    }
+
     void Gateway::body ( const std::string& body )
     {
           // locate the request.
@@ -129,6 +173,57 @@ namespace fcgi {
         ::fcgi_owire_stdi(&myOWire, response.id(), 0, 0);
     }
 
+    void Gateway::open_params ()
+    {
+          // clear contents, but keep the buffer.
+        myParams.clear();
+          // reserve space for the first record header.
+        myRecord = 0;
+        myParams.append(8, '\0');
+    }
+
+    void Gateway::pack_param ( const char * data, size_t size )
+    {
+        while ( size > 0 )
+        {
+              // start a new record when the current one is full, pairs
+              // may span multiple records.
+            const size_t used = myParams.size()-myRecord-8;
+            if ( used == MAXIMUM_CONTENT_LENGTH )
+            {
+                seal_params();
+                myRecord = myParams.size();
+                myParams.append(8, '\0');
+                continue;
+            }
+            const size_t pass = std::min(MAXIMUM_CONTENT_LENGTH-used, size);
+            myParams.append(data, pass);
+            data += pass, size -= pass;
+        }
+    }
+
+    void Gateway::seal_params ()
+    {
+          // patch header of current record now that its length is known.
+        ::fcgi_owire_head(&myParams[myRecord], mySelection->second.id(),
+            4, myParams.size()-myRecord-8);
+    }
+
+    void Gateway::close_params ()
+    {
+          // append an empty record to notify of "end of stream", unless
+          // the current record is already empty.
+        if ( myParams.size()-myRecord > 8 )
+        {
+            seal_params();
+            myRecord = myParams.size();
+            myParams.append(8, '\0');
+        }
+        seal_params();
+          // send everything at once.
+        ::fcgi_owire_write(&myOWire, myParams.data(), myParams.size(), 1);
+    }
+
     void Gateway::accept_record
         ( ::fcgi_iwire * stream, int version, int request, int content )
     {
@@ -243,11 +338,40 @@ namespace fcgi {
         gateway.myRData.clear();
     }
 
-    void Gateway::write_stream
+    size_t Gateway::write_stream
         ( ::fcgi_owire * stream, const char * data, size_t size )
     {
         Gateway& gateway = *static_cast<Gateway*>(stream->object);
-        gateway.gsend(data, size);
+        return (gateway.gsend(data, size));
+    }
+
+    Gateway::ParamTemplate::ParamTemplate ()
+    {
+    }
+
+    void Gateway::ParamTemplate::add
+        ( const std::string& name, const std::string& data )
+    {
+          // encode straight into the buffer.
+        const size_t used = myData.size();
+        myData.resize(used+::fcgi_owire_pair_size(name.size(), data.size()));
+        ::fcgi_owire_pair(&myData[used],
+            name.data(), name.size(), data.data(), data.size());
+    }
+
+    const char * Gateway::ParamTemplate::data () const
+    {
+        return (myData.data());
+    }
+
+    size_t Gateway::ParamTemplate::size () const
+    {
+        return (myData.size());
+    }
+
+    void Gateway::ParamTemplate::clear ()
+    {
+        myData.clear();
     }
 
 }
@@ -15,6 +15,7 @@
  */
 
 #include "fcgi.h"
+#include "Headers.hpp"
 #include "Response.hpp"
 
 #include <map>
@@ -27,6 +28,44 @@ namespace fcgi {
     class Gateway
     {
         /* nested types. */
+    public:
+        /*!
+         * @brief Headers encoded once, sent with many requests.
+         *
+         * Most CGI variables (@c SERVER_SOFTWARE, @c SERVER_NAME,
+         * @c SERVER_PORT, @c GATEWAY_INTERFACE, @c DOCUMENT_ROOT, etc.) never
+         * change for a given virtual host.  Add them to a template once and
+         * pass the template to @c head() to skip encoding them for each
+         * request.
+         */
+        class ParamTemplate
+        {
+            /* data. */
+        private:
+            std::string myData;
+
+            /* construction. */
+        public:
+            ParamTemplate ();
+
+            template<typename Iterator>
+            ParamTemplate ( Iterator begin, const Iterator end )
+            {
+                for ( ; (begin != end); ++begin ) {
+                    add(begin->first, begin->second);
+                }
+            }
+
+            /* methods. */
+        public:
+            void add ( const std::string& name, const std::string& data );
+
+            const char * data () const;
+            size_t size () const;
+
+            void clear ();
+        };
+
     private:
         typedef std::map<Response::Id, Response> Responses;
         typedef Responses::value_type Mapping;
@@ -41,12 +80,21 @@ namespace fcgi {
         std::string myRName;
         std::string myRData;
 
+          // buffer for packed params, offset of current record.
+        std::string myParams;
+        size_t myRecord;
+
         ::fcgi_iwire_settings myISettings; ::fcgi_iwire myIWire;
         ::fcgi_owire_settings myOSettings; ::fcgi_owire myOWire;
 
         /* construction. */
     public:
         Gateway ();
+        virtual ~Gateway ();
+
+    private:
+        Gateway ( const Gateway& );
+        Gateway& operator= ( const Gateway& );
 
         /* methods. */
     public:
@@ -60,20 +108,112 @@ namespace fcgi {
          */
         void gfeed ( const std::string& buffer );
 
+        /*!
+         * @brief Get the amount of output not yet accepted by @c gsend().
+         */
+        size_t pending () const;
+
+        /*!
+         * @brief Send pending output, once the peer (the application) can
+         *  accept more data.
+         * @return Number of bytes still pending.
+         */
+        size_t resume ();
+
         void query ( const std::string& name );
 
         void new_request ( uint16_t request );
         void set_request ( uint16_t request );
 
         void head ( const std::string& name, const std::string& data );
+        void head ( const char * name, const char * data );
         void head ();
+
+        /*!
+         * @brief Send all headers, followed by the end of stream marker.
+         *
+         * Headers are packed into as few records as possible and sent using a
+         * single write.  Do not call @c head() afterwards.
+         */
+        void head ( const Headers& headers );
+
+        /*!
+         * @brief Send headers in [@a begin, @a end), followed by the end of
+         *  stream marker.
+         *
+         * Iterators must refer to pairs of strings, such as those of a
+         * @c std::map or of @c Headers.  Headers are packed into as few
+         * records as possible and sent using a single write.
+         */
+        template<typename Iterator>
+        void head ( Iterator begin, const Iterator end )
+        {
+              // locate the request.
+            if ( mySelection == myResponses.end() ) {
+                return;
+            }
+            open_params();
+            for ( ; (begin != end); ++begin ) {
+                pack_param(begin->first, begin->second);
+            }
+            close_params();
+        }
+
+        /*!
+         * @brief Send pre-encoded headers, followed by the end of stream
+         *  marker.
+         */
+        void head ( const ParamTemplate& prefix );
+
+        /*!
+         * @brief Send pre-encoded headers and per-request headers, followed
+         *  by the end of stream marker.
+         */
+        void head ( const ParamTemplate& prefix, const Headers& headers );
+
+        /*!
+         * @brief Send pre-encoded headers and per-request headers in
+         *  [@a begin, @a end), followed by the end of stream marker.
+         *
+         * The pre-encoded headers are copied as-is, only the per-request
+         * headers are encoded.
+         */
+        template<typename Iterator>
+        void head ( const ParamTemplate& prefix,
+                    Iterator begin, const Iterator end )
+        {
+              // locate the request.
+            if ( mySelection == myResponses.end() ) {
+                return;
+            }
+            open_params();
+            pack_param(prefix.data(), prefix.size());
+            for ( ; (begin != end); ++begin ) {
+                pack_param(begin->first, begin->second);
+            }
+            close_params();
+        }
         void body ( const std::string& name );
         void body ();
 
     protected:
-        virtual void gsend ( const char * data, size_t size )
+        /*!
+         * @brief Check if more records follow the data being written.
+         *
+         * Use this in @c gsend() to send with @c MSG_MORE (or keep @c TCP_CORK
+         * set) until the end of each exchange, so that small records are
+         * packed into full segments.
+         */
+        bool more () const;
+
+        /*!
+         * @brief Write data to the peer.
+         * @return Number of bytes accepted.  Any remainder is kept until
+         *  @c resume() is called.
+         */
+        virtual size_t gsend ( const char * data, size_t size )
         {
-            gsend(std::string(data, size));
+            gsend(std::string(data, size)); return (size);
         }
 
         virtual void gsend ( const std::string& data ) {}
@@ -109,6 +249,24 @@ namespace fcgi {
         virtual void reply
             ( const std::string& name, const std::string& data ) = 0;
 
+    private:
+        void open_params ();
+        void pack_param ( const char * data, size_t size );
+
+          // accepts any string type, e.g. Headers::String.
+        template<typename String>
+        void pack_param ( const String& name, const String& data )
+        {
+            char head[8];
+            pack_param(head,
+                ::fcgi_owire_pair_head(head, name.size(), data.size()));
+            pack_param(name.data(), name.size());
+            pack_param(data.data(), data.size());
+        }
+
+        void seal_params ();
+        void close_params ();
+
         /* class methods. */
     private:
         static void accept_record
@@ -128,7 +286,7 @@ namespace fcgi {
 
         static void finish_request ( ::fcgi_iwire * stream, uint32_t, uint8_t );
 
-        static void write_stream
+        static size_t write_stream
             ( ::fcgi_owire * stream, const char * data, size_t size );
     };
 
@@ -17,6 +17,7 @@
 namespace fcgi {
 
     Headers::Headers ()
+        : myMapping(std::less<String>(), Mapping::allocator_type(myArena))
     {
         ::fcgi_ipstream_init(&myPStream);
         myPStream.object      = this;
@@ -29,10 +30,20 @@ namespace fcgi {
     }
 
     Headers::Headers ( const Headers& other )
-        : myMapping(other.myMapping),
+        : myMapping(std::less<String>(), Mapping::allocator_type(myArena)),
           myName(other.myName),
           myData(other.myData)
     {
+          // copy into our own arena.
+        const String::allocator_type allocator(myArena);
+        Mapping::const_iterator current = other.myMapping.begin();
+        for ( ; (current != other.myMapping.end()); ++current )
+        {
+            myMapping.insert(Mapping::value_type(
+                String(current->first.data(), current->first.size(), allocator),
+                String(current->second.data(), current->second.size(),
+                       allocator)));
+        }
         ::fcgi_ipstream_init(&myPStream);
         myPStream.object      = this;
         myPStream.accept      = &Headers::accept;
@@ -61,31 +72,50 @@ namespace fcgi {
     std::string Headers::get
         ( const std::string& name, const std::string& fallback ) const
     {
-        Mapping::const_iterator match = myMapping.find(name);
+          // build the key outside of our arena, so that concurrent readers
+          // don't race.  It is the scratch arena's only allocation, which
+          // it reclaims right away.
+        static thread_local Arena scratch(256);
+        const String::allocator_type allocator(scratch);
+        const String key(name.data(), name.size(), allocator);
+        Mapping::const_iterator match = myMapping.find(key);
         if ( match == myMapping.end() ) {
             return (fallback);
         }
-        return (match->second);
+        return (std::string(match->second.data(), match->second.size()));
     }
 
     Headers::const_iterator Headers::begin () const
     {
-        return (myMapping.begin());
+        return (const_iterator(myMapping.begin()));
     }
 
     Headers::const_iterator Headers::end () const
     {
-        return (myMapping.end());
+        return (const_iterator(myMapping.end()));
     }
 
     void Headers::clear ()
     {
           // Clear contents, re-use buffers.
-        Mapping::iterator current = myMapping.begin();
-        const Mapping::iterator end = myMapping.end();
-        for ( ; (current != end); ++current ) {
-            current->second.clear();
-        }
+        myMapping.clear();
+        myArena.reset();
+        myName.clear();
+        myData.clear();
+        ::fcgi_ipstream_clear(&myPStream);
+    }
+
+    size_t Headers::capacity () const
+    {
+        return (myArena.capacity() + myName.capacity() + myData.capacity());
+    }
+
+    void Headers::shrink ()
+    {
+        myMapping.clear();
+        myArena.shrink();
+        std::string().swap(myName);
+        std::string().swap(myData);
     }
 
     void Headers::accept
@@ -136,8 +166,10 @@ namespace fcgi {
     {
         Headers& headers = *static_cast<Headers*>(stream->object);
           // commit header.
-        headers.myMapping.insert(
-            std::make_pair(headers.myName, headers.myData));
+        const String::allocator_type allocator(headers.myArena);
+        headers.myMapping.insert(Mapping::value_type(
+            String(headers.myName.data(), headers.myName.size(), allocator),
+            String(headers.myData.data(), headers.myData.size(), allocator)));
           // clear contents, re-use buffers.
         headers.myName.clear();
         headers.myData.clear();
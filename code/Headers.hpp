@@ -15,6 +15,9 @@
  */
 
 #include "fcgi.h"
+#include "Arena.hpp"
+#include <cstddef>
+#include <iterator>
 #include <map>
 #include <string>
 
@@ -23,16 +26,122 @@ namespace fcgi {
     /*!
      * @group application
      * @brief Convenient storage for HTTP request headers.
+     *
+     * Headers are stored in a private arena, which @c clear() releases in one
+     * step.  Recycled objects parse headers without touching the global heap.
      */
     class Headers
     {
         /* nested types. */
     public:
-        typedef std::map<std::string, std::string> Mapping;
-        typedef Mapping::const_iterator const_iterator;
+        typedef std::basic_string
+            <char, std::char_traits<char>, Allocator<char> > String;
+        typedef std::map<String, String, std::less<String>,
+            Allocator< std::pair<const String, String> > > Mapping;
+
+        /*!
+         * @brief Iterates over headers as pairs of @c std::string, like the
+         *  @c std::map<std::string,std::string> that @c Headers used to be.
+         *
+         * Dereferencing copies the current header out of the arena, and the
+         * result is returned by value.  Use @c base() to read headers in
+         * place, as pairs of @c String.
+         */
+        class const_iterator
+        {
+            /* nested types. */
+        public:
+            typedef std::pair<const std::string, std::string> value_type;
+            typedef value_type reference;
+            typedef std::ptrdiff_t difference_type;
+            typedef std::input_iterator_tag iterator_category;
+
+              // keeps the copy alive for operator->().
+            class pointer
+            {
+                value_type myValue;
+            public:
+                explicit pointer ( const value_type& value )
+                    : myValue(value)
+                {}
+                const value_type * operator-> () const
+                {
+                    return (&myValue);
+                }
+            };
+
+            /* data. */
+        private:
+            Mapping::const_iterator myBase;
+
+            /* construction. */
+        public:
+            const_iterator ()
+            {}
+
+            explicit const_iterator ( Mapping::const_iterator base )
+                : myBase(base)
+            {}
+
+            /* methods. */
+        public:
+            /*!
+             * @brief Obtain the underlying iterator, which refers to pairs of
+             *  @c String in the arena.
+             */
+            Mapping::const_iterator base () const
+            {
+                return (myBase);
+            }
+
+            /* operators. */
+        public:
+            reference operator* () const
+            {
+                return (value_type(
+                    std::string(myBase->first.data(), myBase->first.size()),
+                    std::string(myBase->second.data(), myBase->second.size())));
+            }
+
+            pointer operator-> () const
+            {
+                return (pointer(**this));
+            }
+
+            const_iterator& operator++ ()
+            {
+                ++myBase; return (*this);
+            }
+
+            const_iterator operator++ ( int )
+            {
+                const_iterator copy(*this); ++myBase; return (copy);
+            }
+
+            const_iterator& operator-- ()
+            {
+                --myBase; return (*this);
+            }
+
+            const_iterator operator-- ( int )
+            {
+                const_iterator copy(*this); --myBase; return (copy);
+            }
+
+            bool operator== ( const const_iterator& other ) const
+            {
+                return (myBase == other.myBase);
+            }
+
+            bool operator!= ( const const_iterator& other ) const
+            {
+                return (myBase != other.myBase);
+            }
+        };
 
         /* data. */
     private:
+        Arena myArena;
         Mapping myMapping;
 
         ::fcgi_ipstream myPStream;
@@ -45,11 +154,20 @@ namespace fcgi {
         Headers ();
         Headers ( const Headers& other );
 
+    private:
+        Headers& operator= ( const Headers& );
+
         /* methods. */
     public:
         void feed ( const char * data, size_t size );
         void feed ( const std::string& content );
 
+        /*!
+         * @brief Obtain the value of header @a name, or an empty string.
+         *
+         * Lookups don't modify the headers, so several threads may read the
+         * same headers at once.
+         */
         std::string get ( const std::string& name ) const;
         std::string get
             ( const std::string& name, const std::string& fallback ) const;
@@ -59,6 +177,17 @@ namespace fcgi {
 
         void clear ();
 
+        /*!
+         * @brief Obtain the amount of memory reserved by the arena and parser
+         *  buffers.
+         */
+        size_t capacity () const;
+
+        /*!
+         * @brief Release memory reserved by the arena and parser buffers.
+         */
+        void shrink ();
+
         /* class methods. */
     private:
         static void accept
@@ -15,8 +15,10 @@
  */
 
 #include "Authorizer.hpp"
+#include "StaticRecords.hpp"
 
 #include <b64.hpp>
+#include <vector>
 
 namespace fcgi {
 
@@ -43,13 +45,202 @@ namespace fcgi {
          * @param username Username.
          * @param password Password.
          * @return @c true if the credentials are valid, else @c false.
+         *
+         * When an executor is set (see @c Application::executor()), this runs
+         * on the executor's threads and must be thread-safe.
          */
         virtual bool authorized
             (const std::string& username, const std::string& password) = 0;
 
-        /* overrides. */
-    protected:
-        virtual void handle_authorization (Request& request)
+        /*!
+         * @brief Query the password database for several users at once.
+         * @param usernames Usernames.
+         * @param passwords Passwords, one for each username.
+         * @param granted Receives @c true for each pair of valid credentials,
+         *  else @c false.  Already has one entry for each username.
+         *
+         * Called instead of @c authorized() for requests handed over together
+         * (see @c Application::batch()), so that the database can be queried
+         * for all users in one round trip.  The default implementation calls
+         * @c authorized() for each pair.  Same threading rules as
+         * @c authorized().
+         */
+        virtual void authorized_batch
+            (const std::vector<std::string>& usernames,
+             const std::vector<std::string>& passwords,
+             std::vector<bool>& granted)
+        {
+            for (std::size_t i = 0; i < usernames.size(); ++i) {
+                granted[i] = authorized(usernames[i], passwords[i]);
+            }
+        }
+
+        /* nested types. */
+    private:
+        // Password database lookup, off the I/O thread.
+        class Verification :
+            public Job
+        {
+        private:
+            HttpBasicAuthorizer& myAuthorizer;
+            Request::Id myId;
+            Request::Generation myGeneration;
+            std::string myUsername;
+            std::string myPassword;
+            bool myGranted;
+
+        public:
+            Verification (HttpBasicAuthorizer& authorizer, Request& request,
+                          const std::string& username,
+                          const std::string& password)
+                : myAuthorizer(authorizer), myId(request.id()),
+                  myGeneration(request.generation()), myUsername(username),
+                  myPassword(password), myGranted(false)
+            {}
+
+            virtual void execute ()
+            {
+                myGranted = myAuthorizer.authorized(myUsername, myPassword);
+            }
+
+            virtual void complete ()
+            {
+                myAuthorizer.conclude(
+                    myId, myGeneration, myUsername, myPassword, myGranted);
+            }
+        };
+
+        // Password database lookup for several requests at once.
+        class BatchVerification :
+            public Job
+        {
+        private:
+            HttpBasicAuthorizer& myAuthorizer;
+            std::vector<Request::Id> myIds;
+            std::vector<Request::Generation> myGenerations;
+            std::vector<std::string> myUsernames;
+            std::vector<std::string> myPasswords;
+            std::vector<bool> myGranted;
+
+        public:
+            explicit BatchVerification (HttpBasicAuthorizer& authorizer)
+                : myAuthorizer(authorizer)
+            {}
+
+            bool empty () const
+            {
+                return (myIds.empty());
+            }
+
+            void add (Request& request, const std::string& username,
+                      const std::string& password)
+            {
+                myIds.push_back(request.id());
+                myGenerations.push_back(request.generation());
+                myUsernames.push_back(username);
+                myPasswords.push_back(password);
+            }
+
+            virtual void execute ()
+            {
+                myGranted.assign(myUsernames.size(), false);
+                myAuthorizer.authorized_batch(
+                    myUsernames, myPasswords, myGranted);
+            }
+
+            virtual void complete ()
+            {
+                for (std::size_t i = 0; i < myIds.size(); ++i)
+                {
+                    myAuthorizer.conclude(myIds[i], myGenerations[i],
+                        myUsernames[i], myPasswords[i], myGranted[i]);
+                }
+            }
+        };
+
+        /* data. */
+    private:
+        Records myChallenge;
+
+        /* canned responses. */
+    private:
+        const Records& challenge ()
+        {
+            // The realm is constant, so encode the response once.
+            if (myChallenge.size() == 0)
+            {
+                myChallenge
+                    .stde("No 'Authorization' header.")
+                    .stde()
+                    .stdo(
+                        "Status:401 Authorization required.\r\n"
+                        "WWW-Authenticate: Basic realm=\""
+                        + realm() + "\"\r\n"
+                        "Content-Type:text/html\r\n"
+                        "\r\n"
+                        "<p>Enter your credentials for authorization purposes.</p>"
+                    )
+                    .stdo()
+                    .end_request();
+            }
+            return (myChallenge);
+        }
+
+        static const Records& unsupported ()
+        {
+            // Encoded by the compiler, only request IDs change.
+            static constexpr auto encoded = static_records(
+                static_record<7>(),
+                static_record<6>(
+                    "Status:401 Unsupported authorization method.\r\n"
+                    "Content-Type:text/html\r\n"
+                    "\r\n"
+                    "<h1>Not authorized to access this resource.</h1>"
+                ),
+                static_record<6>(),
+                static_end_request());
+            static const Records records =
+                Records().append(encoded.data(), encoded.size());
+            return (records);
+        }
+
+        static const Records& denied ()
+        {
+            static constexpr auto encoded = static_records(
+                static_record<7>(),
+                static_record<6>(
+                    "Status:401 Invalid credentials.\r\n"
+                    "Content-Type:text/html\r\n"
+                    "\r\n"
+                    "<h1>Not authorized to access this resource.</h1>"
+                ),
+                static_record<6>(),
+                static_end_request());
+            static const Records records =
+                Records().append(encoded.data(), encoded.size());
+            return (records);
+        }
+
+        static const Records& granted ()
+        {
+            static constexpr auto encoded = static_records(
+                static_record<7>(),
+                static_record<6>(
+                    "Status:200 OK.\r\n"
+                    "\r\n"
+                ),
+                static_record<6>(),
+                static_end_request());
+            static const Records records =
+                Records().append(encoded.data(), encoded.size());
+            return (records);
+        }
+
+        /* methods. */
+    private:
+        // Parse the credentials, or answer the request if there are none.
+        bool credentials (Request& request,
+                          std::string& username, std::string& password)
         {
             // Fetch HTTP Basic authorization token.  Expect this to be empty
             // quite frequently since we need to return a HTTP 401 status
@@ -58,18 +249,8 @@ namespace fcgi {
             const std::string authorization =
                 headers.get("HTTP_AUTHORIZATION");
             if (authorization.empty()) {
-                errors("No 'Authorization' header.");
-                errors();
-                output(
-                    "Status:401 Authorization required.\r\n"
-                    "WWW-Authenticate: Basic realm=\"" + realm() + "\"\r\n"
-                    "Content-Type:text/html\r\n"
-                    "\r\n"
-                    "<p>Enter your credentials for authorization purposes.</p>"
-                );
-                output();
-                end_request();
-                return;
+                end_request(request, challenge());
+                return (false);
             }
 
             // Fetch credentials, deny all but "basic" authentication.
@@ -78,97 +259,102 @@ namespace fcgi {
                 std::string scheme;
                 if (!(stream >> scheme) || (scheme != "Basic"))
                 {
-                    errors(
+                    errors(request,
                         "Authorization scheme '"+scheme+"' not supported."
                     );
-                    errors();
-                    output(
-                        "Status:401 Unsupported authorization method.\r\n"
-                        "Content-Type:text/html\r\n"
-                        "\r\n"
-                        "<h1>Not authorized to access this resource.</h1>"
-                    );
-                    output();
-                    end_request();
-                    return;
+                    end_request(request, unsupported());
+                    return (false);
                 }
                 if (!(stream >> std::ws) || !std::getline(stream,credentials))
                 {
-                    errors("Could not read credentials.");
-                    errors();
-                    output(
-                        "Status:401 Invalid credentials.\r\n"
-                        "Content-Type:text/html\r\n"
-                        "\r\n"
-                        "<h1>Not authorized to access this resource.</h1>"
-                    );
-                    output();
-                    end_request();
-                    return;
+                    errors(request, "Could not read credentials.");
+                    end_request(request, denied());
+                    return (false);
                 }
                 credentials = b64::decode(credentials);
             }
 
             // Extract credentials.
-            std::string username;
-            std::string password;
             std::istringstream stream(credentials);
             if (!(stream >> std::ws) || !std::getline(stream,username,':'))
             {
-                errors("Could not extract username.");
-                errors();
-                output(
-                    "Status:401 Invalid credentials.\r\n"
-                    "Content-Type:text/html\r\n"
-                    "\r\n"
-                    "<h1>Not authorized to access this resource.</h1>"
-                );
-                output();
-                end_request();
-                return;
+                errors(request, "Could not extract username.");
+                end_request(request, denied());
+                return (false);
             }
             if (!(stream >> std::ws) || !std::getline(stream,password))
             {
-                errors("Could not extract password.");
-                errors();
-                output(
-                    "Status:401 Invalid credentials.\r\n"
-                    "Content-Type:text/html\r\n"
-                    "\r\n"
-                    "<h1>Not authorized to access this resource.</h1>"
-                );
-                output();
-                end_request();
+                errors(request, "Could not extract password.");
+                end_request(request, denied());
+                return (false);
+            }
+            return (true);
+        }
+
+        // Answer the request once the password database was queried.
+        void conclude (Request::Id id, Request::Generation generation,
+                       const std::string& username,
+                       const std::string& password, bool granted)
+        {
+            // The request may have been aborted in the mean time, and its
+            // ID and object reused for another request.
+            Request *const current = this->request(id, generation);
+            if (current == 0) {
                 return;
             }
+            Request& request = *current;
+            if (granted) {
+                end_request(request, HttpBasicAuthorizer::granted());
+                return;
+            }
+            errors(request, "Invalid credentials:\n");
+            errors(request, "  username='"+username+"',\n");
+            errors(request, "  password='"+password+"'.\n");
+            end_request(request, denied());
+        }
 
-            // Validate credentials.
-            if (authorized(username,password))
-            {
-                errors();
-                output(
-                    "Status:200 OK.\r\n"
-                    "\r\n"
-                );
-                output();
-                end_request();
+        /* overrides. */
+    protected:
+        virtual void handle_authorization (Request& request)
+        {
+            std::string username;
+            std::string password;
+            if (!credentials(request, username, password)) {
                 return;
             }
-            else {
-                errors("Invalid credentials:\n");
-                errors("  username='"+username+"',\n");
-                errors("  password='"+password+"'.\n");
-                errors();
-                output(
-                    "Status:401 Invalid credentials.\r\n"
-                    "Content-Type:text/html\r\n"
-                    "\r\n"
-                    "<h1>Not authorized to access this resource.</h1>"
-                );
-                output();
-                end_request();
+
+            // Validate credentials, the database may be slow.
+            dispatch(request,
+                new Verification(*this, request, username, password));
+        }
+
+        virtual void handle_batch
+            (Request * const * requests, std::size_t count)
+        {
+            BatchVerification * batch = new BatchVerification(*this);
+            std::vector<Request*> members;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                Request& request = *requests[i];
+                if (request.role() != Role::authorizer()) {
+                    end_of_head(request);
+                    continue;
+                }
+                std::string username;
+                std::string password;
+                if (credentials(request, username, password)) {
+                    batch->add(request, username, password);
+                    members.push_back(&request);
+                }
+            }
+
+            // Validate all credentials in one database query, scheduled
+            // by the most urgent request.
+            if (batch->empty()) {
+                delete batch;
                 return;
             }
+            dispatch(&members[0], members.size(), batch);
         }
     };
 
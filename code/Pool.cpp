@@ -0,0 +1,79 @@
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Pool.cpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include "Pool.hpp"
+
+namespace fcgi {
+
+    const size_t Pool::DEFAULT_HIGHWATER;
+
+    Pool::Pool ( size_t highwater )
+        : myHighwater(highwater), myRetained(0)
+    {
+    }
+
+    Pool::~Pool ()
+    {
+        for ( size_t i = 0; (i < myIdle.size()); ++i ) {
+            delete myIdle[i];
+        }
+    }
+
+    Request * Pool::acquire ( Request::Id id )
+    {
+        if ( myIdle.empty() ) {
+            return (new Request(id));
+        }
+        Request * request = myIdle.back(); myIdle.pop_back();
+        myRetained -= request->capacity();
+        request->reset(id);
+        return (request);
+    }
+
+    void Pool::release ( Request * request )
+    {
+        request->clear();
+          // free buffers rather than exceed the high-water mark.
+        if ( (myRetained + request->capacity()) > myHighwater ) {
+            request->shrink();
+        }
+        myRetained += request->capacity();
+        myIdle.push_back(request);
+    }
+
+    size_t Pool::highwater () const
+    {
+        return (myHighwater);
+    }
+
+    void Pool::highwater ( size_t highwater )
+    {
+        myHighwater = highwater;
+          // trim idle requests until under the new mark.
+        for ( size_t i = 0; (i < myIdle.size()); ++i )
+        {
+            if ( myRetained <= myHighwater ) {
+                break;
+            }
+            myRetained -= myIdle[i]->capacity();
+            myIdle[i]->shrink();
+            myRetained += myIdle[i]->capacity();
+        }
+    }
+
+    size_t Pool::retained () const
+    {
+        return (myRetained);
+    }
+
+}
@@ -0,0 +1,85 @@
+#ifndef _fcgi_Pool_hpp__
+#define _fcgi_Pool_hpp__
+
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Pool.hpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include "Request.hpp"
+
+#include <vector>
+
+namespace fcgi {
+
+    /*!
+     * @group application
+     * @brief Recycles request objects, along with their buffers.
+     *
+     * Idle requests keep their buffers, up to @c highwater() bytes in total.
+     * A request released while the pool is above that mark has its buffers
+     * freed, so one large upload does not pin memory for the lifetime of the
+     * connection.
+     */
+    class Pool
+    {
+        /* class data. */
+    public:
+        static const size_t DEFAULT_HIGHWATER = 1024*1024;
+
+        /* data. */
+    private:
+        std::vector<Request*> myIdle;
+        size_t myHighwater;
+        size_t myRetained;
+
+        /* construction. */
+    public:
+        explicit Pool ( size_t highwater=DEFAULT_HIGHWATER );
+        ~Pool ();
+
+    private:
+        Pool ( const Pool& );
+        Pool& operator= ( const Pool& );
+
+        /* methods. */
+    public:
+        /*!
+         * @brief Obtain an empty request object for request @a id.
+         */
+        Request * acquire ( Request::Id id );
+
+        /*!
+         * @brief Hand a request object back to the pool.
+         */
+        void release ( Request * request );
+
+        /*!
+         * @brief Obtain the maximum amount of buffer memory kept by idle
+         *  request objects.
+         */
+        size_t highwater () const;
+
+        /*!
+         * @brief Change the maximum amount of buffer memory kept by idle
+         *  request objects.
+         */
+        void highwater ( size_t highwater );
+
+        /*!
+         * @brief Obtain the amount of buffer memory kept by idle requests.
+         */
+        size_t retained () const;
+    };
+
+}
+
+#endif /* _fcgi_Pool_hpp__ */
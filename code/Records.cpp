@@ -0,0 +1,188 @@
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Records.cpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief Pre-encoded FastCGI records.
+ */
+
+#include "Records.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+    const size_t MAXIMUM_CONTENT_LENGTH = (1 << 16)-1;
+
+}
+
+namespace fcgi {
+
+    Records::Records ()
+    {
+    }
+
+    Records& Records::record ( int type, const char * data, size_t size )
+    {
+        size_t used = 0;
+        do {
+            const size_t pass = std::min(size-used, MAXIMUM_CONTENT_LENGTH);
+              // keep track of header, to patch request ID later.
+            myHeads.push_back(myData.size());
+            myData.resize(myData.size()+8);
+            ::fcgi_owire_head(&myData[myHeads.back()], 0, type, pass);
+            if ( pass > 0 ) {
+                myData.append(data+used, pass);
+            }
+            used += pass;
+        }
+        while ( used < size );
+        return (*this);
+    }
+
+    Records& Records::record ( int type, const std::string& data )
+    {
+        return (record(type, data.data(), data.size()));
+    }
+
+    Records& Records::append ( const Records& records )
+    {
+        const size_t base = myData.size();
+        myData.append(records.myData);
+        for ( size_t i = 0; (i < records.myHeads.size()); ++i ) {
+            myHeads.push_back(base + records.myHeads[i]);
+        }
+        return (*this);
+    }
+
+    Records& Records::append ( const char * data, size_t size )
+    {
+        const size_t base = myData.size();
+        myData.append(data, size);
+          // find each record header, to patch request ID later.
+        const unsigned char *const bytes =
+            reinterpret_cast<const unsigned char*>(data);
+        for ( size_t i = 0; (i+8 <= size); )
+        {
+            myHeads.push_back(base + i);
+            i += 8 + ((bytes[i+4]<<8)|bytes[i+5]) + bytes[i+6];
+        }
+        return (*this);
+    }
+
+    Records& Records::new_request ( uint16_t role, uint8_t flags )
+    {
+        const char body[8] = {
+            char((role>>8)&0xff), char(role&0xff), // role
+            char(flags),                           // flags
+            0, 0, 0, 0, 0,                         // reserved
+        };
+        return (record(1, body, 8));
+    }
+
+    Records& Records::bad_request ()
+    {
+        return (record(2, 0, 0));
+    }
+
+    Records& Records::end_request ( uint32_t astatus, uint8_t pstatus )
+    {
+        const char body[8] = {
+            char((astatus>>24)&0xff), char((astatus>>16)&0xff), // app status
+            char((astatus>> 8)&0xff), char((astatus>> 0)&0xff), // (continued)
+            char(pstatus),                                       // protocol
+            0, 0, 0,                                             // reserved
+        };
+        return (record(3, body, 8));
+    }
+
+    Records& Records::param
+        ( const std::string& name, const std::string& data )
+    {
+        std::string pair(::fcgi_owire_pair_size(name.size(), data.size()), 0);
+        ::fcgi_owire_pair(&pair[0],
+            name.data(), name.size(), data.data(), data.size());
+        return (record(4, pair));
+    }
+
+    Records& Records::param ()
+    {
+        return (record(4, 0, 0));
+    }
+
+    Records& Records::stdi ( const std::string& data )
+    {
+        return (record(5, data));
+    }
+
+    Records& Records::stdi ()
+    {
+        return (record(5, 0, 0));
+    }
+
+    Records& Records::stdo ( const std::string& data )
+    {
+        return (record(6, data));
+    }
+
+    Records& Records::stdo ()
+    {
+        return (record(6, 0, 0));
+    }
+
+    Records& Records::stde ( const std::string& data )
+    {
+        return (record(7, data));
+    }
+
+    Records& Records::stde ()
+    {
+        return (record(7, 0, 0));
+    }
+
+    const char * Records::data () const
+    {
+        return (myData.data());
+    }
+
+    size_t Records::size () const
+    {
+        return (myData.size());
+    }
+
+    void Records::copy ( char * buffer, uint16_t request ) const
+    {
+        std::memcpy(buffer, myData.data(), myData.size());
+          // patch request ID in each record header.
+        std::vector<size_t>::const_iterator current = myHeads.begin();
+        const std::vector<size_t>::const_iterator end = myHeads.end();
+        for ( ; (current != end); ++current )
+        {
+            buffer[*current+2] = char((request>>8)&0xff);
+            buffer[*current+3] = char((request>>0)&0xff);
+        }
+    }
+
+    void Records::clear ()
+    {
+        myData.clear();
+        myHeads.clear();
+    }
+
+    size_t Records::capacity () const
+    {
+        return (myData.capacity() + myHeads.capacity()*sizeof(size_t));
+    }
+
+    void Records::shrink ()
+    {
+        std::string().swap(myData);
+        std::vector<size_t>().swap(myHeads);
+    }
+
+}
@@ -0,0 +1,117 @@
+#ifndef _fcgi_Records_hpp__
+#define _fcgi_Records_hpp__
+
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Records.hpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief Pre-encoded FastCGI records.
+ */
+
+#include "fcgi.h"
+#include <string>
+#include <vector>
+
+namespace fcgi {
+
+    /*!
+     * @brief Sequence of records encoded once, sent for any request.
+     *
+     * Use this for fixed content, such as canned responses or test fixtures.
+     * Records are encoded when they are added.  Sending them only requires a
+     * copy, patching the request ID in each record header.
+     *
+     * @code
+     *  static const fcgi::Records granted = fcgi::Records()
+     *      .stde()
+     *      .stdo("Status:200 OK.\r\n\r\n")
+     *      .stdo()
+     *      .end_request();
+     * @endcode
+     */
+    class Records
+    {
+        /* data. */
+    private:
+        std::string myData;
+        std::vector<size_t> myHeads;
+
+        /* construction. */
+    public:
+        Records ();
+
+        /* methods. */
+    public:
+        /*!
+         * @brief Append record(s) of any type.
+         *
+         * Content larger than a single record is split across multiple
+         * records.  Empty content appends a single empty record, which marks
+         * the end of stream records.
+         */
+        Records& record ( int type, const char * data, size_t size );
+        Records& record ( int type, const std::string& data );
+
+        /*!
+         * @brief Append all of @a records.
+         */
+        Records& append ( const Records& records );
+
+        /*!
+         * @brief Append records that are already encoded, such as
+         *  @c StaticRecords.
+         */
+        Records& append ( const char * data, size_t size );
+
+        Records& new_request ( uint16_t role, uint8_t flags=0 );
+        Records& bad_request ();
+        Records& end_request ( uint32_t astatus=0, uint8_t pstatus=0 );
+
+        Records& param ( const std::string& name, const std::string& data );
+        Records& param ();
+        Records& stdi ( const std::string& data );
+        Records& stdi ();
+        Records& stdo ( const std::string& data );
+        Records& stdo ();
+        Records& stde ( const std::string& data );
+        Records& stde ();
+
+        /*!
+         * @brief Obtain the encoded records, with a request ID of 0.
+         */
+        const char * data () const;
+
+        /*!
+         * @brief Obtain the size of the encoded records, in bytes.
+         */
+        size_t size () const;
+
+        /*!
+         * @brief Copy the encoded records, setting the request ID.
+         * @param buffer Buffer of at least @c size() bytes.
+         * @param request Request ID.
+         */
+        void copy ( char * buffer, uint16_t request ) const;
+
+        void clear ();
+
+        /*!
+         * @brief Obtain the amount of memory reserved by buffers.
+         */
+        size_t capacity () const;
+
+        /*!
+         * @brief Release memory reserved by buffers.
+         */
+        void shrink ();
+    };
+
+}
+
+#endif /* _fcgi_Records_hpp__ */
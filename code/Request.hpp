@@ -16,7 +16,10 @@
 
 #include "fcgi.h"
 #include "Headers.hpp"
+#include "Records.hpp"
 #include "Role.hpp"
+#include "Rope.hpp"
+#include "Spool.hpp"
 
 namespace fcgi {
 
@@ -29,21 +32,43 @@ namespace fcgi {
         /* nested types. */
     public:
         typedef uint16_t Id;
+        typedef unsigned long Generation;
 
         /* data. */
     private:
-        const Id myId;
+        Id myId;
+        Generation myGeneration;
 	Role myRole;
         Headers myHead;
         std::string myBody;
+        Spool mySpool;
+        Rope myRope;
+        std::string myData;
+        Spool myDataSpool;
+
+          // copy of the output, see Application::capture().
+        Records myTranscript;
+        bool myCapturing;
 
         bool myPrepared;
         bool myComplete;
+        bool myAborted;
+        bool myRejected;
+
+          // scheduling, see Application::classify().
+        int myPriority;
+        double myDeadline;
+
+          // time FCGI_BEGIN_REQUEST was received.
+        double myArrival;
 
         /* construction. */
     public:
         Request ( Id id )
-            : myId(id), myHead()
+            : myId(id), myGeneration(0), myHead(), myCapturing(false),
+              myPrepared(false), myComplete(false), myAborted(false),
+              myRejected(false),
+              myPriority(0), myDeadline(0.0), myArrival(0.0)
         {}
 
         /* methods. */
@@ -53,10 +78,72 @@ namespace fcgi {
             return (myId);
         }
 
+        /*!
+         * @brief Obtain the number that distinguishes this request from
+         *  earlier ones that used the same object.
+         *
+         * Request objects are recycled, so keep this value along with the
+         * request's ID to find it later, see @c Application::request().
+         */
+        Generation generation () const
+        {
+            return (myGeneration);
+        }
+
+        void generation ( Generation generation )
+        {
+            myGeneration = generation;
+        }
+
         void clear ()
         {
             myHead.clear();
             myBody.clear();
+            mySpool.close();
+            myRope.clear();
+            myData.clear();
+            myDataSpool.close();
+            myTranscript.clear();
+        }
+
+        /*!
+         * @brief Recycle the request object for a new request.
+         *
+         * Contents are cleared, but buffers are kept.
+         */
+        void reset ( Id id )
+        {
+            myId = id;
+            myRole = Role();
+            myCapturing = false;
+            myPrepared = false;
+            myComplete = false;
+            myAborted = false;
+            myRejected = false;
+            myPriority = 0;
+            myDeadline = 0.0;
+            myArrival = 0.0;
+            clear();
+        }
+
+        /*!
+         * @brief Obtain the amount of memory reserved by buffers.
+         */
+        size_t capacity () const
+        {
+            return (myHead.capacity() + myBody.capacity() + myData.capacity()
+                + myTranscript.capacity());
+        }
+
+        /*!
+         * @brief Release memory reserved by buffers.
+         */
+        void shrink ()
+        {
+            myHead.shrink();
+            std::string().swap(myBody);
+            std::string().swap(myData);
+            myTranscript.shrink();
         }
 
 	void role ( const Role& role )
@@ -89,6 +176,66 @@ namespace fcgi {
             return (myBody);
         }
 
+        /*!
+         * @brief Access body content spilled to a temporary file.
+         *
+         * When the body grows past the application's spool threshold, its
+         * content is moved here and @c body() stays empty.  Check
+         * @c Spool::is_open() to find where the content is.
+         */
+        Spool& spool ()
+        {
+            return (mySpool);
+        }
+
+        const Spool& spool () const
+        {
+            return (mySpool);
+        }
+
+        /*!
+         * @brief Access body content kept as slices of received buffers.
+         *
+         * Only used when the application enables it, see
+         * @c Application::rope().
+         */
+        Rope& rope ()
+        {
+            return (myRope);
+        }
+
+        const Rope& rope () const
+        {
+            return (myRope);
+        }
+
+        /*!
+         * @brief Access the file to filter (@c FCGI_DATA stream).
+         */
+        std::string& data ()
+        {
+            return (myData);
+        }
+
+        const std::string& data () const
+        {
+            return (myData);
+        }
+
+        /*!
+         * @brief Access file content spilled to a temporary file.
+         * @see spool()
+         */
+        Spool& data_spool ()
+        {
+            return (myDataSpool);
+        }
+
+        const Spool& data_spool () const
+        {
+            return (myDataSpool);
+        }
+
         bool prepared () const
         {
             return (myPrepared);
@@ -108,6 +255,100 @@ namespace fcgi {
         {
             myComplete = complete;
         }
+
+        /*!
+         * @brief Check if the gateway aborted the request.
+         */
+        bool aborted () const
+        {
+            return (myAborted);
+        }
+
+        void aborted ( bool aborted )
+        {
+            myAborted = aborted;
+        }
+
+        /*!
+         * @brief Check if the application answered the request with a 503
+         *  response because its deadline passed.
+         */
+        bool rejected () const
+        {
+            return (myRejected);
+        }
+
+        void rejected ( bool rejected )
+        {
+            myRejected = rejected;
+        }
+
+        /*!
+         * @brief Obtain the request's priority, higher runs first.
+         */
+        int priority () const
+        {
+            return (myPriority);
+        }
+
+        void priority ( int priority )
+        {
+            myPriority = priority;
+        }
+
+        /*!
+         * @brief Obtain the time past which the response is useless, in
+         *  seconds since the Unix epoch.  Zero means no deadline.
+         */
+        double deadline () const
+        {
+            return (myDeadline);
+        }
+
+        void deadline ( double deadline )
+        {
+            myDeadline = deadline;
+        }
+
+        /*!
+         * @brief Obtain the time the request began, in seconds since the
+         *  Unix epoch.
+         */
+        double arrival () const
+        {
+            return (myArrival);
+        }
+
+        void arrival ( double arrival )
+        {
+            myArrival = arrival;
+        }
+
+        /*!
+         * @brief Check if output is copied to @c transcript().
+         */
+        bool capturing () const
+        {
+            return (myCapturing);
+        }
+
+        void capturing ( bool capturing )
+        {
+            myCapturing = capturing;
+        }
+
+        /*!
+         * @brief Access the records sent while @c capturing().
+         */
+        Records& transcript ()
+        {
+            return (myTranscript);
+        }
+
+        const Records& transcript () const
+        {
+            return (myTranscript);
+        }
     };
 
 }
@@ -0,0 +1,89 @@
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Requests.cpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include "Requests.hpp"
+
+namespace fcgi {
+
+    Requests::Requests ()
+        : myPool(), mySize(0)
+    {
+        for ( size_t i = 0; (i < 256); ++i ) {
+            myPages[i] = 0;
+        }
+    }
+
+    Requests::~Requests ()
+    {
+        for ( size_t i = 0; (i < 256); ++i )
+        {
+            if ( myPages[i] == 0 ) {
+                continue;
+            }
+            for ( size_t j = 0; (j < 256); ++j )
+            {
+                if ( myPages[i]->slots[j] != 0 ) {
+                    myPool.release(myPages[i]->slots[j]);
+                }
+            }
+            delete myPages[i];
+        }
+    }
+
+    Request * Requests::find ( Request::Id id ) const
+    {
+        const Page * page = myPages[(id>>8)&0xff];
+        if ( page == 0 ) {
+            return (0);
+        }
+        return (page->slots[id&0xff]);
+    }
+
+    Request& Requests::acquire ( Request::Id id )
+    {
+        Page *& page = myPages[(id>>8)&0xff];
+          // might be the first use of this range of request IDs.
+        if ( page == 0 ) {
+            page = new Page();
+        }
+        Request *& slot = page->slots[id&0xff];
+          // might be the first use of this request ID.
+        if ( slot == 0 ) {
+            slot = myPool.acquire(id), ++mySize;
+        }
+        return (*slot);
+    }
+
+    void Requests::release ( Request::Id id )
+    {
+        Page * page = myPages[(id>>8)&0xff];
+        if ( page == 0 ) {
+            return;
+        }
+        Request *& slot = page->slots[id&0xff];
+        if ( slot != 0 ) {
+            myPool.release(slot), slot = 0, --mySize;
+        }
+    }
+
+    size_t Requests::size () const
+    {
+        return (mySize);
+    }
+
+    Pool& Requests::pool ()
+    {
+        return (myPool);
+    }
+
+}
@@ -0,0 +1,82 @@
+#ifndef _fcgi_Requests_hpp__
+#define _fcgi_Requests_hpp__
+
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Requests.hpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include "Pool.hpp"
+#include "Request.hpp"
+
+namespace fcgi {
+
+    /*!
+     * @group application
+     * @brief Table of in-flight requests, indexed by request ID.
+     *
+     * The 16-bit request ID space is split in 256 pages of 256 slots, pages
+     * are allocated on first use.  Lookups are two array accesses.  Request
+     * objects are recycled through a @c Pool.
+     */
+    class Requests
+    {
+        /* nested types. */
+    private:
+        struct Page { Request * slots[256]; };
+
+        /* data. */
+    private:
+        Pool myPool;
+        Page * myPages[256];
+        size_t mySize;
+
+        /* construction. */
+    public:
+        Requests ();
+        ~Requests ();
+
+    private:
+        Requests ( const Requests& );
+        Requests& operator= ( const Requests& );
+
+        /* methods. */
+    public:
+        /*!
+         * @brief Locate an in-flight request.
+         * @return The request, or 0 if there is no such request.
+         */
+        Request * find ( Request::Id id ) const;
+
+        /*!
+         * @brief Locate an in-flight request, create it if necessary.
+         */
+        Request& acquire ( Request::Id id );
+
+        /*!
+         * @brief Return a request to the pool, freeing its ID.
+         */
+        void release ( Request::Id id );
+
+        /*!
+         * @brief Obtain the number of in-flight requests.
+         */
+        size_t size () const;
+
+        /*!
+         * @brief Access the pool of recycled request objects.
+         */
+        Pool& pool ();
+    };
+
+}
+
+#endif /* _fcgi_Requests_hpp__ */
@@ -0,0 +1,172 @@
+#ifndef _fcgi_Responder_hpp__
+#define _fcgi_Responder_hpp__
+
+// Copyright(c) 2011-2012, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Responder.hpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include "Application.hpp"
+#include "Cache.hpp"
+
+#include <map>
+#include <string>
+
+namespace fcgi {
+
+    class Responder :
+        public Application
+    {
+        /* data. */
+    private:
+        Cache * myCache;
+
+        // keys of requests regenerating a cache entry.
+        std::map<Request::Id, std::string> myKeys;
+
+        /* construction. */
+    public:
+        Responder ()
+            : myCache(0)
+        {}
+
+        /* methods. */
+    public:
+        /*!
+         * @brief Answer @c GET and @c HEAD requests from @a cache.
+         *
+         * Hits are replayed without calling @c handle_request(), misses are
+         * captured and stored once the handler ends the request.  Use 0 (the
+         * default) to disable caching.  The cache must outlive the
+         * responder.  Subclasses that override @c end_of_head(),
+         * @c end_of_body(), @c captured() or @c promoted() must call these
+         * versions.
+         */
+        void cache (Cache * cache)
+        {
+            myCache = cache;
+        }
+
+        /* contract. */
+    protected:
+        /*!
+         * @brief Handle request, once its body was received.
+         */
+        virtual void handle_request (fcgi::Request& request) = 0;
+
+        /*!
+         * @brief Obtain the key under which identical @c GET and @c HEAD
+         *  requests are coalesced.
+         *
+         * Requests arriving while another one with the same key and the
+         * same method is still being handled receive its output instead of
+         * being handled.  The default implementation returns an empty key,
+         * which disables coalescing.  See @c Application::flights() to
+         * coalesce requests of different connections.
+         */
+        virtual std::string flight (const fcgi::Request&)
+        {
+            return (std::string());
+        }
+
+        /*!
+         * @brief Check if the response to @a request may be stored in the
+         *  cache.
+         *
+         * The default implementation uses @c Cache::cacheable(), which
+         * skips errors and responses that set cookies.
+         */
+        virtual bool cacheable
+            (const fcgi::Request&, const Records& records)
+        {
+            return (Cache::cacheable(records));
+        }
+
+        /* overrides. */
+    protected:
+        virtual void end_of_head (fcgi::Request& request)
+        {
+            // Only handle responder requests.
+            if (request.role() != fcgi::Role::responder())
+            {
+                errors(request,
+                    "This is a responder, not an authorizer or filter."
+                );
+                errors(request);
+                output(request);
+                end_request(request, 1);
+                return;
+            }
+
+            // Only cache and coalesce idempotent requests.
+            const std::string method = request.head().get("REQUEST_METHOD");
+            if ((method != "GET") && (method != "HEAD")) {
+                return;
+            }
+            if (myCache != 0)
+            {
+                const std::string key = myCache->key(request);
+                const Records * records = 0;
+                if (myCache->find(key, records) == Cache::hit) {
+                    end_request(request, *records);
+                    return;
+                }
+                myKeys[request.id()] = key;
+                capture(request);
+            }
+            // HEAD waiters must not receive a GET body.
+            const std::string key = flight(request);
+            if (!key.empty()) {
+                coalesce(request, method + ' ' + key);
+            }
+        }
+
+        virtual void end_of_body (fcgi::Request& request)
+        {
+            // Waiters receive the leader's output.
+            if (!waiting(request)) {
+                handle_request(request);
+            }
+        }
+
+        virtual void promoted (fcgi::Request& request)
+        {
+            // Otherwise, end_of_body() will handle it.
+            if (request.complete()) {
+                handle_request(request);
+            }
+        }
+
+        virtual void captured (fcgi::Request& request, const Records& records)
+        {
+            const std::map<Request::Id, std::string>::iterator match =
+                myKeys.find(request.id());
+            if (match == myKeys.end()) {
+                return;
+            }
+            if (myCache != 0)
+            {
+                // Don't cache partial output, errors or private responses.
+                if (request.aborted() || request.rejected() ||
+                    !cacheable(request, records)) {
+                    myCache->abandon(match->second);
+                }
+                else {
+                    myCache->store(match->second, records);
+                }
+            }
+            myKeys.erase(match);
+        }
+    };
+
+}
+
+#endif /* _fcgi_Responder_hpp__ */
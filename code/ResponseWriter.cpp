@@ -0,0 +1,142 @@
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file ResponseWriter.cpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include "ResponseWriter.hpp"
+
+#include <cstring>
+
+namespace {
+
+      // formats @a value in decimal, returns the number of digits.
+    size_t format ( char * buffer, size_t value )
+    {
+        char digits[20];
+        size_t size = 0;
+        do {
+            digits[size++] = char('0' + (value % 10)), value /= 10;
+        }
+        while ( value > 0 );
+        for ( size_t i = 0; (i < size); ++i ) {
+            buffer[i] = digits[size-1-i];
+        }
+        return (size);
+    }
+
+}
+
+namespace fcgi {
+
+    ResponseWriter::ResponseWriter
+        ( Application& application, Request& request )
+        : myApplication(application), myRequest(request), myContentLength(0)
+    {
+        myParts.reserve(16), mySizes.reserve(16);
+    }
+
+    ResponseWriter& ResponseWriter::status
+        ( unsigned int code, const char * reason )
+    {
+          // the status line has room for three digits only.
+        if ( (code < 100) || (code > 999) ) {
+            code = 500;
+        }
+        size_t used = format(myStatus, code);
+        myStatus[used++] = ' ';
+        part("Status: ", 8);
+        part(myStatus, used);
+        part(reason, std::strlen(reason));
+        part("\r\n", 2);
+        return (*this);
+    }
+
+    ResponseWriter& ResponseWriter::header
+        ( const char * name, const char * value )
+    {
+        part(name, std::strlen(name));
+        part(": ", 2);
+        part(value, std::strlen(value));
+        part("\r\n", 2);
+        return (*this);
+    }
+
+    ResponseWriter& ResponseWriter::header
+        ( const char * name, const std::string& value )
+    {
+        part(name, std::strlen(name));
+        part(": ", 2);
+        part(value.data(), value.size());
+        part("\r\n", 2);
+        return (*this);
+    }
+
+    ResponseWriter& ResponseWriter::header ( const char * name,
+        const char * prefix, const std::string& value, const char * suffix )
+    {
+        part(name, std::strlen(name));
+        part(": ", 2);
+        part(prefix, std::strlen(prefix));
+        part(value.data(), value.size());
+        part(suffix, std::strlen(suffix));
+        part("\r\n", 2);
+        return (*this);
+    }
+
+    ResponseWriter& ResponseWriter::body ( const char * data, size_t size )
+    {
+        if ( size > 0 ) {
+            myBodyParts.push_back(data);
+            myBodySizes.push_back(size);
+            myContentLength += size;
+        }
+        return (*this);
+    }
+
+    ResponseWriter& ResponseWriter::body ( const char * data )
+    {
+        return (body(data, std::strlen(data)));
+    }
+
+    ResponseWriter& ResponseWriter::body ( const std::string& data )
+    {
+        return (body(data.data(), data.size()));
+    }
+
+    size_t ResponseWriter::content_length () const
+    {
+        return (myContentLength);
+    }
+
+    void ResponseWriter::send ()
+    {
+        part("Content-Length: ", 16);
+        part(myLength, format(myLength, myContentLength));
+        part("\r\n\r\n", 4);
+        myParts.insert(myParts.end(), myBodyParts.begin(), myBodyParts.end());
+        mySizes.insert(mySizes.end(), myBodySizes.begin(), myBodySizes.end());
+        myApplication.output
+            (myRequest, &myParts[0], &mySizes[0], myParts.size());
+          // all fragments were sent (or queued), start over.
+        myParts.clear(), mySizes.clear();
+        myBodyParts.clear(), myBodySizes.clear();
+        myContentLength = 0;
+    }
+
+    void ResponseWriter::part ( const char * data, size_t size )
+    {
+        if ( size > 0 ) {
+            myParts.push_back(data);
+            mySizes.push_back(size);
+        }
+    }
+
+}
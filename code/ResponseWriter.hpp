@@ -0,0 +1,116 @@
+#ifndef _fcgi_ResponseWriter_hpp__
+#define _fcgi_ResponseWriter_hpp__
+
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file ResponseWriter.hpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include "Application.hpp"
+
+#include <string>
+#include <vector>
+
+namespace fcgi {
+
+    /*!
+     * @group application
+     * @brief Encodes a CGI response straight into the application's output.
+     *
+     * The writer only records references to the status, headers and body
+     * fragments.  @c send() then gathers them into @c FCGI_STDOUT records,
+     * adding a @c Content-Length header that matches the body.  All fragments
+     * must stay valid and unchanged until @c send() returns.
+     *
+     * @code
+     *  ResponseWriter(*this, request)
+     *      .status(401, "Authorization required")
+     *      .header("WWW-Authenticate", "Basic realm=\"", realm(), "\"")
+     *      .header("Content-Type", "text/html")
+     *      .body("<p>Enter your credentials.</p>")
+     *      .send();
+     * @endcode
+     */
+    class ResponseWriter
+    {
+        /* data. */
+    private:
+        Application& myApplication;
+        Request& myRequest;
+
+          // status line and headers, then body fragments.
+        std::vector<const char*> myParts;
+        std::vector<size_t> mySizes;
+        std::vector<const char*> myBodyParts;
+        std::vector<size_t> myBodySizes;
+        size_t myContentLength;
+
+          // storage for formatted numbers.
+        char myStatus[16];
+        char myLength[24];
+
+        /* construction. */
+    public:
+        ResponseWriter ( Application& application, Request& request );
+
+    private:
+        ResponseWriter ( const ResponseWriter& );
+        ResponseWriter& operator= ( const ResponseWriter& );
+
+        /* methods. */
+    public:
+        /*!
+         * @brief Set the HTTP status, e.g. @c 404 and @c "Not Found".
+         *
+         * Without it, the gateway assumes @c 200.  Codes outside 100..999
+         * are sent as @c 500.
+         */
+        ResponseWriter& status ( unsigned int code, const char * reason );
+
+        /*!
+         * @brief Add a header.
+         *
+         * The value may be given in up to three fragments, which are sent
+         * back to back.
+         */
+        ResponseWriter& header ( const char * name, const char * value );
+        ResponseWriter& header ( const char * name, const std::string& value );
+        ResponseWriter& header ( const char * name, const char * prefix,
+            const std::string& value, const char * suffix );
+
+        /*!
+         * @brief Append a fragment to the body.
+         */
+        ResponseWriter& body ( const char * data, size_t size );
+        ResponseWriter& body ( const char * data );
+        ResponseWriter& body ( const std::string& data );
+
+        /*!
+         * @brief Obtain the size of the body, in bytes.
+         */
+        size_t content_length () const;
+
+        /*!
+         * @brief Send the complete response.
+         *
+         * The standard output stream is left open, end it (and the request)
+         * with @c Application::output() and @c Application::end_request().
+         * The writer is then empty and may be reused.
+         */
+        void send ();
+
+    private:
+        void part ( const char * data, size_t size );
+    };
+
+}
+
+#endif /* _fcgi_ResponseWriter_hpp__ */
@@ -0,0 +1,107 @@
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Rope.cpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include "Rope.hpp"
+
+namespace fcgi {
+
+    Rope::Rope ()
+        : mySize(0)
+    {
+    }
+
+    void Rope::append ( const Buffer& buffer, size_t offset, size_t size )
+    {
+        if ( size == 0 ) {
+            return;
+        }
+        mySlices.push_back(Slice(buffer, offset, size));
+        mySize += size;
+    }
+
+    void Rope::append ( const char * data, size_t size )
+    {
+        if ( size == 0 ) {
+            return;
+        }
+        std::string content(data, size);
+        append(Buffer(content), 0, size);
+    }
+
+    size_t Rope::size () const
+    {
+        return (mySize);
+    }
+
+    bool Rope::empty () const
+    {
+        return (mySize == 0);
+    }
+
+    size_t Rope::slices () const
+    {
+        return (mySlices.size());
+    }
+
+    Rope::const_iterator Rope::begin () const
+    {
+        return (mySlices.begin());
+    }
+
+    Rope::const_iterator Rope::end () const
+    {
+        return (mySlices.end());
+    }
+
+    void Rope::clear ()
+    {
+        mySlices.clear();
+        mySize = 0;
+    }
+
+    void Rope::flatten ( std::string& content ) const
+    {
+        content.reserve(content.size() + mySize);
+        for ( size_t i = 0; (i < mySlices.size()); ++i ) {
+            content.append(mySlices[i].data(), mySlices[i].size());
+        }
+    }
+
+    std::string Rope::flatten () const
+    {
+        std::string content;
+        flatten(content);
+        return (content);
+    }
+
+#ifndef _WIN32
+    size_t Rope::iovecs
+        ( ::iovec * vectors, size_t count, size_t offset ) const
+    {
+        size_t used = 0;
+        for ( size_t i = 0; (i < mySlices.size()) && (used < count); ++i )
+        {
+            const Slice& slice = mySlices[i];
+              // skip content already consumed.
+            if ( offset >= slice.size() ) {
+                offset -= slice.size(); continue;
+            }
+            vectors[used].iov_base = const_cast<char*>(slice.data()) + offset;
+            vectors[used].iov_len = slice.size() - offset;
+            offset = 0, ++used;
+        }
+        return (used);
+    }
+#endif
+
+}
@@ -0,0 +1,142 @@
+#ifndef _fcgi_Rope_hpp__
+#define _fcgi_Rope_hpp__
+
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Rope.hpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include "Buffer.hpp"
+
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#   include <sys/uio.h>
+#endif
+
+namespace fcgi {
+
+    /*!
+     * @group application
+     * @brief Content made of slices of reference-counted buffers.
+     *
+     * Appending a slice only takes a reference to the buffer, so content
+     * received once is never copied again.  The rope can be walked slice by
+     * slice, handed to @c writev() or flattened into contiguous memory when
+     * a parser insists on it.
+     *
+     * @note Like @c Buffer, this is not thread-safe.
+     */
+    class Rope
+    {
+        /* nested types. */
+    public:
+        /*!
+         * @brief Contiguous part of the content.
+         */
+        class Slice
+        {
+            /* data. */
+        private:
+            Buffer myBuffer;
+            size_t myOffset;
+            size_t mySize;
+
+            /* construction. */
+        public:
+            Slice ( const Buffer& buffer, size_t offset, size_t size )
+                : myBuffer(buffer), myOffset(offset), mySize(size)
+            {}
+
+            /* methods. */
+        public:
+            const Buffer& buffer () const
+            {
+                return (myBuffer);
+            }
+
+            const char * data () const
+            {
+                return (myBuffer.data() + myOffset);
+            }
+
+            size_t size () const
+            {
+                return (mySize);
+            }
+        };
+
+        typedef std::vector<Slice>::const_iterator const_iterator;
+
+        /* data. */
+    private:
+        std::vector<Slice> mySlices;
+        size_t mySize;
+
+        /* construction. */
+    public:
+        Rope ();
+
+        /* methods. */
+    public:
+        /*!
+         * @brief Append @a size bytes of @a buffer, starting at @a offset.
+         */
+        void append ( const Buffer& buffer, size_t offset, size_t size );
+
+        /*!
+         * @brief Append a copy of @a data.
+         */
+        void append ( const char * data, size_t size );
+
+        /*!
+         * @brief Obtain the size of the content, in bytes.
+         */
+        size_t size () const;
+
+        bool empty () const;
+
+        /*!
+         * @brief Obtain the number of slices.
+         */
+        size_t slices () const;
+
+        const_iterator begin () const;
+        const_iterator end () const;
+
+        /*!
+         * @brief Drop the content, releasing references to the buffers.
+         */
+        void clear ();
+
+        /*!
+         * @brief Copy the content into contiguous memory.
+         */
+        void flatten ( std::string& content ) const;
+        std::string flatten () const;
+
+#ifndef _WIN32
+        /*!
+         * @brief Describe the content for @c writev().
+         * @param vectors Output, at least @a count entries.
+         * @param count Maximum number of entries to fill.
+         * @param offset Number of bytes to skip, e.g. already written.
+         * @return Number of entries filled.
+         */
+        size_t iovecs
+            ( ::iovec * vectors, size_t count, size_t offset=0 ) const;
+#endif
+    };
+
+}
+
+#endif /* _fcgi_Rope_hpp__ */
@@ -0,0 +1,175 @@
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Spool.cpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include "Spool.hpp"
+
+#ifndef _WIN32
+#   include <sys/mman.h>
+#   include <cerrno>
+#   include <cstdlib>
+#   include <string>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+namespace {
+
+#ifndef _WIN32
+    int create_file ()
+    {
+#ifdef MFD_CLOEXEC
+        const int memory = ::memfd_create("fcgi-spool", MFD_CLOEXEC);
+        if ( memory != -1 ) {
+            return (memory);
+        }
+#endif
+          // no anonymous memory files, fall back to an unlinked file.
+        const char * folder = ::getenv("TMPDIR");
+        std::string path(folder? folder : "/tmp");
+        path += "/fcgi-spool-XXXXXX";
+        const int handle = ::mkstemp(&path[0]);
+        if ( handle != -1 )
+        {
+            ::unlink(path.c_str());
+            ::fcntl(handle, F_SETFD, FD_CLOEXEC);
+        }
+        return (handle);
+    }
+#endif
+
+}
+
+namespace fcgi {
+
+    Spool::Spool ()
+        : myHandle(-1), mySize(0), myView(0), myMapped(0)
+    {
+    }
+
+    Spool::~Spool ()
+    {
+        close();
+    }
+
+    bool Spool::open ()
+    {
+        close();
+#ifndef _WIN32
+        myHandle = create_file();
+#endif
+        return (myHandle != -1);
+    }
+
+    bool Spool::is_open () const
+    {
+        return (myHandle != -1);
+    }
+
+    size_t Spool::write ( const char * data, size_t size )
+    {
+        size_t used = 0;
+#ifndef _WIN32
+        while ( (myHandle != -1) && (used < size) )
+        {
+            const ::ssize_t pass = ::write(myHandle, data+used, size-used);
+            if ( pass < 0 )
+            {
+                if ( errno == EINTR ) {
+                    continue;
+                }
+                break;
+            }
+            used += pass;
+        }
+#endif
+        mySize += used;
+        return (used);
+    }
+
+    size_t Spool::read ( size_t offset, char * data, size_t size ) const
+    {
+        size_t used = 0;
+#ifndef _WIN32
+        while ( (myHandle != -1) && (used < size) )
+        {
+            const ::ssize_t pass =
+                ::pread(myHandle, data+used, size-used, offset+used);
+            if ( pass < 0 )
+            {
+                if ( errno == EINTR ) {
+                    continue;
+                }
+                break;
+            }
+            if ( pass == 0 ) {
+                break;
+            }
+            used += pass;
+        }
+#endif
+        return (used);
+    }
+
+    int Spool::handle () const
+    {
+        return (myHandle);
+    }
+
+    size_t Spool::size () const
+    {
+        return (mySize);
+    }
+
+    const char * Spool::data () const
+    {
+#ifndef _WIN32
+          // content was added since the last mapping.
+        if ( myMapped != mySize ) {
+            unmap();
+        }
+        if ( (myView == 0) && (mySize > 0) )
+        {
+            void *const view =
+                ::mmap(0, mySize, PROT_READ, MAP_SHARED, myHandle, 0);
+            if ( view == MAP_FAILED ) {
+                return (0);
+            }
+            myView = view, myMapped = mySize;
+        }
+#endif
+        return (static_cast<const char*>(myView));
+    }
+
+    void Spool::close ()
+    {
+        unmap();
+#ifndef _WIN32
+        if ( myHandle != -1 ) {
+            ::close(myHandle);
+        }
+#endif
+        myHandle = -1;
+        mySize = 0;
+    }
+
+    void Spool::unmap () const
+    {
+#ifndef _WIN32
+        if ( myView != 0 ) {
+            ::munmap(myView, myMapped);
+        }
+#endif
+        myView = 0, myMapped = 0;
+    }
+
+}
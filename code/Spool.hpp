@@ -0,0 +1,107 @@
+#ifndef _fcgi_Spool_hpp__
+#define _fcgi_Spool_hpp__
+
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file Spool.hpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief High-level API for FastCGI application server implementation.
+ */
+
+#include <cstddef>
+
+namespace fcgi {
+
+    /*!
+     * @group application
+     * @brief Anonymous temporary file holding content too large for memory.
+     *
+     * Content is appended to an unnamed file (@c memfd_create() where
+     * available, an unlinked temporary file elsewhere) and can be read back
+     * through a read-only memory mapping, or handed to @c sendfile() through
+     * its file descriptor.  Spooling is not supported on Windows.
+     */
+    class Spool
+    {
+        /* data. */
+    private:
+        int myHandle;
+        size_t mySize;
+
+          // read-only view, remapped when content is added.
+        mutable void * myView;
+        mutable size_t myMapped;
+
+        /* construction. */
+    public:
+        Spool ();
+        ~Spool ();
+
+    private:
+        Spool ( const Spool& );
+        Spool& operator= ( const Spool& );
+
+        /* methods. */
+    public:
+        /*!
+         * @brief Create the backing file.
+         * @return @c false if spooling is not possible.
+         */
+        bool open ();
+
+        /*!
+         * @brief Check if the backing file exists.
+         */
+        bool is_open () const;
+
+        /*!
+         * @brief Append content to the file.
+         * @return Number of bytes written, less than @a size on error.
+         */
+        size_t write ( const char * data, size_t size );
+
+        /*!
+         * @brief Copy content starting at @a offset, without mapping the
+         *  file.
+         * @return Number of bytes copied, less than @a size on error or past
+         *  the end of the content.
+         */
+        size_t read ( size_t offset, char * data, size_t size ) const;
+
+        /*!
+         * @brief Obtain the file descriptor, e.g. for @c sendfile().
+         * @return The file descriptor, or -1 if the spool is not open.
+         */
+        int handle () const;
+
+        /*!
+         * @brief Obtain the amount of content in the file.
+         */
+        size_t size () const;
+
+        /*!
+         * @brief Obtain a read-only view of the file's contents.
+         * @return A pointer to @c size() bytes, or 0 if the file is empty or
+         *  cannot be mapped.  The view is invalidated by @c write() and
+         *  @c close().
+         */
+        const char * data () const;
+
+        /*!
+         * @brief Release the view and the backing file.
+         */
+        void close ();
+
+    private:
+        void unmap () const;
+    };
+
+}
+
+#endif /* _fcgi_Spool_hpp__ */
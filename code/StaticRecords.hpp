@@ -0,0 +1,254 @@
+#ifndef _fcgi_StaticRecords_hpp__
+#define _fcgi_StaticRecords_hpp__
+
+// Copyright(c) 2011, Andre Caron (andre.l.caron@gmail.com)
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file StaticRecords.hpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief FastCGI records encoded at compile time.
+ */
+
+#include "fcgi.h"
+#include <array>
+#include <cstddef>
+#include <cstring>
+
+namespace fcgi {
+
+    template<std::size_t N> class StaticRecords;
+
+    namespace detail {
+
+        template<std::size_t... I> struct indices {};
+
+        template<typename Lhs, typename Rhs> struct join_indices;
+
+        template<std::size_t... I, std::size_t... J>
+        struct join_indices< indices<I...>, indices<J...> >
+        {
+            typedef indices<I..., (sizeof...(I)+J)...> type;
+        };
+
+          // halve N at each step, so that records of up to 64 KiB stay
+          // within the compiler's template instantiation depth.
+        template<std::size_t N>
+        struct make_indices :
+            join_indices<typename make_indices<N/2>::type,
+                         typename make_indices<N-N/2>::type>
+        {
+        };
+
+        template<>
+        struct make_indices<0>
+        {
+            typedef indices<> type;
+        };
+
+        template<>
+        struct make_indices<1>
+        {
+            typedef indices<0> type;
+        };
+
+        template<std::size_t... N> struct total;
+
+        template<>
+        struct total<>
+        {
+            static const std::size_t value = 0;
+        };
+
+        template<std::size_t N, std::size_t... M>
+        struct total<N, M...>
+        {
+            static const std::size_t value = N + total<M...>::value;
+        };
+
+    }
+
+    /*!
+     * @brief Sequence of records encoded by the compiler, with a request ID
+     *  of 0.
+     *
+     * Build these with @c static_record(), @c static_end_request() and
+     * @c static_records(), then use @c copy() to set the request ID.  Pass
+     * @c data() and @c size() to @c Records::append() to send them with the
+     * application's @c end_request().
+     *
+     * @code
+     *  static constexpr auto granted = fcgi::static_records(
+     *      fcgi::static_record<7>(),
+     *      fcgi::static_record<6>("Status:200 OK.\r\n\r\n"),
+     *      fcgi::static_record<6>(),
+     *      fcgi::static_end_request());
+     * @endcode
+     */
+    template<std::size_t N>
+    class StaticRecords
+    {
+        /* data. */
+    private:
+        char myData[N];
+
+        /* construction. */
+    public:
+        template<typename... Bytes>
+        constexpr StaticRecords ( Bytes... bytes )
+            : myData{char(bytes)...}
+        {
+        }
+
+        /* methods. */
+    public:
+        constexpr const char * data () const
+        {
+            return (myData);
+        }
+
+        constexpr std::size_t size () const
+        {
+            return (N);
+        }
+
+        constexpr char operator[] ( std::size_t i ) const
+        {
+            return (myData[i]);
+        }
+
+        /*!
+         * @brief Obtain the encoded records as an array.
+         */
+        constexpr std::array<char, N> array () const
+        {
+            return (array(typename detail::make_indices<N>::type()));
+        }
+
+        /*!
+         * @brief Copy the encoded records, setting the request ID.
+         * @param buffer Buffer of at least @c size() bytes.
+         * @param request Request ID.
+         */
+        void copy ( char * buffer, uint16_t request ) const
+        {
+            std::memcpy(buffer, myData, N);
+              // patch request ID in each record header.
+            const unsigned char *const data =
+                reinterpret_cast<const unsigned char*>(myData);
+            for ( std::size_t i = 0; (i+8 <= N); )
+            {
+                buffer[i+2] = char((request>>8)&0xff);
+                buffer[i+3] = char((request>>0)&0xff);
+                i += 8 + ((data[i+4]<<8)|data[i+5]) + data[i+6];
+            }
+        }
+
+    private:
+        template<std::size_t... I>
+        constexpr std::array<char, N> array ( detail::indices<I...> ) const
+        {
+            return (std::array<char, N>{{myData[I]...}});
+        }
+    };
+
+    namespace detail {
+
+        template<int Type, std::size_t N>
+        constexpr char record_byte
+            ( const char (&content)[N], std::size_t i )
+        {
+            return ((i == 0)? char(1)                    // version
+                  : (i == 1)? char(Type)                 // type
+                  : (i == 4)? char(((N-1)>>8)&0xff)      // content length
+                  : (i == 5)? char(((N-1)>>0)&0xff)      // (continued)
+                  : (i <  8)? char(0)                    // ID, padding, ...
+                  : content[i-8]);
+        }
+
+        template<int Type, std::size_t N, std::size_t... I>
+        constexpr StaticRecords<N+7> record
+            ( const char (&content)[N], indices<I...> )
+        {
+            return (StaticRecords<N+7>(record_byte<Type>(content, I)...));
+        }
+
+        template<std::size_t N>
+        constexpr char pick ( std::size_t i, const StaticRecords<N>& part )
+        {
+            return (part[i]);
+        }
+
+        template<std::size_t N, std::size_t... M>
+        constexpr char pick ( std::size_t i, const StaticRecords<N>& first,
+                              const StaticRecords<M>&... rest )
+        {
+            return ((i < N)? first[i] : pick(i-N, rest...));
+        }
+
+        template<std::size_t... N, std::size_t... I>
+        constexpr StaticRecords<total<N...>::value> join
+            ( indices<I...>, const StaticRecords<N>&... parts )
+        {
+            return (StaticRecords<total<N...>::value>(pick(I, parts...)...));
+        }
+
+    }
+
+    /*!
+     * @brief Encode a record of type @a Type holding a string literal.
+     *
+     * The terminating null character is not part of the content, which
+     * may hold up to 65535 bytes.
+     */
+    template<int Type, std::size_t N>
+    constexpr StaticRecords<N+7> static_record ( const char (&content)[N] )
+    {
+        static_assert(N-1 <= 0xffff, "content does not fit in one record.");
+        return (detail::record<Type>(content,
+            typename detail::make_indices<N+7>::type()));
+    }
+
+    /*!
+     * @brief Encode an empty record of type @a Type, which marks the end of
+     *  stream records.
+     */
+    template<int Type>
+    constexpr StaticRecords<8> static_record ()
+    {
+        return (StaticRecords<8>(1, Type, 0, 0, 0, 0, 0, 0));
+    }
+
+    constexpr StaticRecords<16> static_new_request
+        ( uint16_t role, uint8_t flags=0 )
+    {
+        return (StaticRecords<16>(1, 1, 0, 0, 0, 8, 0, 0,
+            (role>>8)&0xff, role&0xff, flags, 0, 0, 0, 0, 0));
+    }
+
+    constexpr StaticRecords<16> static_end_request
+        ( uint32_t astatus=0, uint8_t pstatus=0 )
+    {
+        return (StaticRecords<16>(1, 3, 0, 0, 0, 8, 0, 0,
+            (astatus>>24)&0xff, (astatus>>16)&0xff,
+            (astatus>> 8)&0xff, (astatus>> 0)&0xff, pstatus, 0, 0, 0));
+    }
+
+    /*!
+     * @brief Concatenate sequences of records.
+     */
+    template<std::size_t... N>
+    constexpr StaticRecords<detail::total<N...>::value> static_records
+        ( const StaticRecords<N>&... parts )
+    {
+        return (detail::join(typename detail::make_indices<
+            detail::total<N...>::value>::type(), parts...));
+    }
+
+}
+
+#endif /* _fcgi_StaticRecords_hpp__ */
@@ -23,14 +23,30 @@ namespace fcgi {}
 
 #include "ostream.hpp"
 
+#include "Admission.hpp"
 #include "Application.hpp"
+#include "Arena.hpp"
+#include "Buffer.hpp"
+#include "Cache.hpp"
+#include "Coroutine.hpp"
+#include "Executor.hpp"
+#include "Flights.hpp"
 #include "Gateway.hpp"
 #include "Headers.hpp"
+#include "Pool.hpp"
+#include "Records.hpp"
 #include "Request.hpp"
+#include "Requests.hpp"
 #include "Response.hpp"
+#include "ResponseWriter.hpp"
+#include "Rope.hpp"
+#include "Spool.hpp"
+#include "StaticRecords.hpp"
 
 // Application models.
 #include "Authorizer.hpp"
+#include "Filter.hpp"
 #include "HttpBasicAuthorizer.hpp"
+#include "Responder.hpp"
 
 #endif /* _fcgi_hpp__ */
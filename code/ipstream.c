@@ -23,36 +23,45 @@ static size_t _fcgi_ipstream_dsize(fcgi_ipstream*,const char*,size_t);
 static size_t _fcgi_ipstream_ndata(fcgi_ipstream*,const char*,size_t);
 static size_t _fcgi_ipstream_ddata(fcgi_ipstream*,const char*,size_t);
 
-static size_t _fcgi_ipstream_nsize
+static size_t _fcgi_ipstream_stage
     ( fcgi_ipstream * stream, const char * data, size_t size )
 {
-    int n = 0;
     size_t used = 0;
-    while ((size > 0) && (stream->staged < 4))
+    while ((used < size) && (stream->staged < 4))
     {
-        if ( stream->staged == 0 )
+          /* when length <= 127, length is only one byte. */
+        if ((stream->staged == 0) && !(data[used] & 0x80))
         {
-            n = (int)data[used++];
-            stream->staging[0] = n;
-            if ( n <= 127 ) {
-                stream->staging[1] = 0;
-                stream->staging[2] = 0;
-                stream->staging[3] = 0;
-                stream->staged = 4;
-            }
+            stream->staging[0] = 0;
+            stream->staging[1] = 0;
+            stream->staging[2] = 0;
+            stream->staging[3] = data[used++];
+            stream->staged = 4;
         }
-        if ( stream->staged < 4 ) {
+        else {
             stream->staging[stream->staged++] = data[used++];
         }
     }
+    return (used);
+}
+
+static size_t _fcgi_ipstream_length ( fcgi_ipstream * stream )
+{
+    stream->staged = 0;
+    return
+        ((size_t)(unsigned char)(stream->staging[0]&0x7f) << 24|
+         (size_t)(unsigned char)(stream->staging[1]     ) << 16|
+         (size_t)(unsigned char)(stream->staging[2]     ) <<  8|
+         (size_t)(unsigned char)(stream->staging[3]     ) <<  0);
+}
+
+static size_t _fcgi_ipstream_nsize
+    ( fcgi_ipstream * stream, const char * data, size_t size )
+{
+    size_t used = _fcgi_ipstream_stage(stream, data, size);
     if ( stream->staged == 4 )
     {
-        stream->nsize = stream->npass =
-            (uint32_t)(unsigned char)stream->staging[0] <<  0|
-            (uint32_t)(unsigned char)stream->staging[1] <<  8|
-            (uint32_t)(unsigned char)stream->staging[2] << 16|
-            (uint32_t)(unsigned char)stream->staging[3] << 24;
-        stream->staged = 0;
+        stream->nsize = stream->npass = _fcgi_ipstream_length(stream);
         stream->state = &_fcgi_ipstream_dsize;
     }
     return (used);
@@ -61,37 +70,18 @@ static size_t _fcgi_ipstream_nsize
 static size_t _fcgi_ipstream_dsize
     ( fcgi_ipstream * stream, const char * data, size_t size )
 {
-    int n = 0;
-    size_t used = 0;
-    while ((size > 0) && (stream->staged < 4))
-    {
-        if ( stream->staged == 0 )
-        {
-            n = (int)data[used++];
-            stream->staging[0] = n;
-            if ( n <= 127 ) {
-                stream->staging[1] = 0;
-                stream->staging[2] = 0;
-                stream->staging[3] = 0;
-                stream->staged = 4;
-            }
-        }
-        if ( stream->staged < 4 ) {
-            stream->staging[stream->staged++] = data[used++];
-        }
-    }
+    size_t used = _fcgi_ipstream_stage(stream, data, size);
     if ( stream->staged == 4 )
     {
-        stream->dsize = stream->dpass =
-            (uint32_t)(unsigned char)stream->staging[0] <<  0|
-            (uint32_t)(unsigned char)stream->staging[1] <<  8|
-            (uint32_t)(unsigned char)stream->staging[2] << 16|
-            (uint32_t)(unsigned char)stream->staging[3] << 24;
-        stream->staged = 0;
+        stream->dsize = stream->dpass = _fcgi_ipstream_length(stream);
         if ( stream->accept ) {
             stream->accept(stream, stream->nsize, stream->dsize);
         }
         stream->state = &_fcgi_ipstream_ndata;
+          /* empty names don't wait for more data. */
+        if ( stream->npass == 0 ) {
+            used += _fcgi_ipstream_ndata(stream, data+used, 0);
+        }
     }
     return (used);
 }
@@ -110,6 +100,10 @@ static size_t _fcgi_ipstream_ndata
             stream->finish_name(stream);
         }
         stream->state = &_fcgi_ipstream_ddata;
+          /* empty values don't wait for more data. */
+        if ( stream->dpass == 0 ) {
+            used += _fcgi_ipstream_ddata(stream, data+used, 0);
+        }
     }
     return (used);
 }
@@ -162,6 +156,8 @@ void fcgi_ipstream_clear ( fcgi_ipstream * stream )
     stream->dsize = 0;
     stream->npass = 0;
     stream->dpass = 0;
+    stream->staged = 0;
+    stream->state = &_fcgi_ipstream_nsize;
 }
 
 size_t fcgi_ipstream_feed ( fcgi_ipstream * stream, const char * data, size_t size )
@@ -109,6 +109,10 @@ static size_t fcgi_parse_header
         stream->accept_record(stream, version, request, stream->size);
           /* ditch staged data. */
         stream->staged = 0;
+          /* signal abortion right away, the record has no content. */
+        if ((reqtype == fcgi_iwire_record_bail) && stream->cancel_request) {
+            stream->cancel_request(stream);
+        }
           /* for stream records with empty payload, signal end of stream. */
         if ((reqtype >= fcgi_iwire_record_meta) &&
             (reqtype <= fcgi_iwire_record_data) && (stream->size == 0))
@@ -165,77 +169,80 @@ static size_t fcgi_forward_stuff_data ( fcgi_iwire * stream,
     return (used);
 }
 
-static size_t fcgi_accept_stuff (
-    fcgi_iwire * stream, const char * data, size_t size,
-    accept_ended complete, accept_stuff accept_name, accept_stuff accept_data )
+static size_t fcgi_stage_length
+    ( fcgi_iwire * stream, const char * data, size_t size, size_t base )
 {
-    int n = 0;
     size_t used = 0;
-      /* read prefixed lengths. */
-    while ((size > 0) && (stream->staged < 8))
+    while ((used < size) && (stream->staged < base+4))
     {
-          /* when length < 127, length is only one byte. */
-        if ( stream->staged == 0 )
+          /* when length <= 127, length is only one byte. */
+        if ((stream->staged == base) && !(data[used] & 0x80))
         {
-            n = (int)data[used++];
-            stream->staging[0] = n;
-            if ( n <= 127 ) {
-                stream->staging[1] = 0;
-                stream->staging[2] = 0;
-                stream->staging[3] = 0;
-                stream->staged = 4;
-            }
+            stream->staging[base+0] = 0;
+            stream->staging[base+1] = 0;
+            stream->staging[base+2] = 0;
+            stream->staging[base+3] = data[used++];
+            stream->staged = base+4;
         }
-        if ( stream->staged < 4 ) {
+        else {
             stream->staging[stream->staged++] = data[used++];
         }
-          /* when length < 127, length is only one byte. */
-        if ( stream->staged == 4 )
+    }
+    return (used);
+}
+
+static uint32_t fcgi_parse_length ( const char * staging )
+{
+    return
+        ((uint32_t)(unsigned char)(staging[0]&0x7f) << 24|
+         (uint32_t)(unsigned char)(staging[1]     ) << 16|
+         (uint32_t)(unsigned char)(staging[2]     ) <<  8|
+         (uint32_t)(unsigned char)(staging[3]     ) <<  0);
+}
+
+static size_t fcgi_accept_stuff (
+    fcgi_iwire * stream, const char * data, size_t size,
+    accept_ended complete, accept_stuff accept_name, accept_stuff accept_data )
+{
+    size_t used = 0;
+      /* don't read past the end of the record. */
+    size = _fcgi_iwire_min(stream->size, size);
+      /* a record may hold any number of pairs. */
+    while ( used < size )
+    {
+          /* between pairs, read prefixed lengths. */
+        if ((stream->ksize == 0) && (stream->vsize == 0))
         {
-            n = (int)data[used++];
-            stream->staging[4] = n;
-            if ( n <= 127 ) {
-                stream->staging[5] = 0;
-                stream->staging[6] = 0;
-                stream->staging[7] = 0;
-                stream->staged = 8;
+            if ( stream->staged < 4 ) {
+                used += fcgi_stage_length(stream, data+used, size-used, 0);
             }
+            if ( stream->staged >= 4 ) {
+                used += fcgi_stage_length(stream, data+used, size-used, 4);
+            }
+            if ( stream->staged < 8 ) {
+                break;
+            }
+            stream->ksize = fcgi_parse_length(stream->staging+0);
+            stream->vsize = fcgi_parse_length(stream->staging+4);
+            stream->staged = 0;
         }
-        if ( stream->staged < 8 ) {
-            stream->staging[stream->staged++] = data[used++];
-        }
-    }
-      /* after reading lengths, interpret content. */
-    if ((stream->staged == 8) && (stream->ksize == 0) && (stream->vsize == 0))
-    {
-        stream->ksize =
-            (uint32_t)(unsigned char)stream->staging[0] <<  0|
-            (uint32_t)(unsigned char)stream->staging[1] <<  8|
-            (uint32_t)(unsigned char)stream->staging[2] << 16|
-            (uint32_t)(unsigned char)stream->staging[3] << 24;
-        stream->vsize =
-            (uint32_t)(unsigned char)stream->staging[4] <<  0|
-            (uint32_t)(unsigned char)stream->staging[5] <<  8|
-            (uint32_t)(unsigned char)stream->staging[6] << 16|
-            (uint32_t)(unsigned char)stream->staging[7] << 24;
-    }
-      /* forward trailing data. */
-    while ((stream->staged == 8) && (used < size) &&
-        ((stream->ksize > 0) || (stream->vsize > 0)))
-    {
+          /* forward trailing data. */
         if (stream->ksize > 0) {
             used += fcgi_forward_stuff_name(
                 stream, data+used, size-used, accept_name);
         }
-        else if (stream->vsize > 0) {
+        if ((stream->ksize == 0) && (stream->vsize > 0) && (used < size)) {
             used += fcgi_forward_stuff_data(
                 stream, data+used, size-used, accept_data);
         }
+          /* signal end of pair. */
+        if ((stream->ksize == 0) && (stream->vsize == 0)) {
+            complete(stream);
+        }
     }
       /* update parser state. */
     stream->size -= used;
     if ( stream->size == 0 ) {
-        complete(stream);
         stream->state = fcgi_iwire_record_skip;
     }
     return (used);
@@ -268,11 +275,13 @@ static size_t FCGI_BEGIN_REQUEST
 static size_t FCGI_ABORT_REQUEST
     ( fcgi_iwire * stream, const char * data, size_t size )
 {
-      /* signal abortion. */
-    stream->cancel_request(stream);
-      /* start skipping padding. */
-    stream->state = fcgi_iwire_record_skip;
-    return (0);
+      /* abortion was signaled with the record header, ignore content. */
+    size_t used = _fcgi_iwire_min(stream->size, size);
+    stream->size -= used;
+    if ( stream->size == 0 ) {
+        stream->state = fcgi_iwire_record_skip;
+    }
+    return (used);
 }
 
 static size_t FCGI_END_REQUEST
@@ -312,7 +321,7 @@ static size_t FCGI_PARAMS
     }
       /* forward data as usual. */
     if ( stream->accept_headers ) {
-        stream->accept_headers(stream, data, size);
+        stream->accept_headers(stream, data, used);
     }
     stream->size -= used;
     if ( stream->size == 0 ) {
@@ -362,7 +371,7 @@ static size_t FCGI_STDOUT
     if ((stream->size > 0) && (used == 0)) {
         return (used);
     }
-    stream->accept_content_stdo(stream, data, size);
+    stream->accept_content_stdo(stream, data, used);
       /* adjust parser state. */
     stream->size -= used;
     if ( stream->size == 0 ) {
@@ -380,7 +389,7 @@ static size_t FCGI_STDERR
     if ((stream->size > 0) && (used == 0)) {
         return (used);
     }
-    stream->accept_content_stde(stream, data, size);
+    stream->accept_content_stde(stream, data, used);
       /* adjust parser state. */
     stream->size -= used;
     if ( stream->size == 0 ) {
@@ -394,16 +403,13 @@ static size_t FCGI_DATA
 {
       /* consume as much data as possible. */
     size_t used = _fcgi_iwire_min(stream->size, size);
-      /* signal end of headers when possible. */
-    if ( stream->size == 0 )
-    {
-        if ( stream->finish_headers ) {
-            stream->finish_headers(stream);
-        }
-        stream->state = fcgi_iwire_record_skip;
+      /* don't forward empty record until we actually have none left. */
+    if ((stream->size > 0) && (used == 0)) {
         return (used);
     }
-    stream->accept_content_data(stream, data, size);
+    if ( stream->accept_content_data ) {
+        stream->accept_content_data(stream, data, used);
+    }
       /* adjust parser state. */
     stream->size -= used;
     if ( stream->size == 0 ) {
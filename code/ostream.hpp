@@ -39,6 +39,11 @@ namespace fcgi {
             myWire.flush_stream = &ostream::flush_stream;
         }
 
+        ~ostream ()
+        {
+            ::fcgi_owire_clear(&myWire);
+        }
+
         /* methods. */
     public:
         void new_request ( uint16_t request, int role )
@@ -59,17 +64,17 @@ namespace fcgi {
 
         void cant_multiplex ( uint16_t request, uint32_t astatus=0 )
         {
-            end_request(request, astatus, 1);
+            end_request(request, astatus, FCGI_CANT_MPX_CONN);
         }
 
         void overloaded ( uint16_t request, uint32_t astatus=0 )
         {
-            end_request(request, astatus, 2);
+            end_request(request, astatus, FCGI_OVERLOADED);
         }
 
         void unknown_role ( uint16_t request, uint32_t astatus=0 )
         {
-            end_request(request, astatus, 3);
+            end_request(request, astatus, FCGI_UNKNOWN_ROLE);
         }
 
         void param ( uint16_t request, const char * data, uint16_t size )
@@ -169,10 +174,11 @@ namespace fcgi {
 
         /* class methods. */
     private:
-        static void write_stream
+        static size_t write_stream
             ( fcgi_owire * stream, const char * data, size_t size )
         {
             static_cast<ostream*>(stream->object)->myStream.write(data, size);
+            return (size);
         }
 
         static void flush_stream ( fcgi_owire * stream )
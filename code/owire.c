@@ -12,6 +12,7 @@
  */
 
 #include "owire.h"
+#include <stdlib.h>
 #include <string.h>
 
 #define MAXIMUM_CONTENT_LENGTH ((1 << 16)-1)
@@ -19,6 +20,7 @@
 static const char * fcgi_owire_error_messages[] =
 {
     "no error, writer ok",
+    "out of memory, output dropped",
 };
 
 static size_t _fcgi_owire_min ( size_t a, size_t b )
@@ -26,6 +28,93 @@ static size_t _fcgi_owire_min ( size_t a, size_t b )
     return ((a < b)? a : b);
 }
 
+const char * fcgi_owire_error_message ( fcgi_owire_error error )
+{
+    return (fcgi_owire_error_messages[error]);
+}
+
+static void _fcgi_owire_queue
+    ( fcgi_owire * stream, const char * data, size_t size )
+{
+    char * queue = 0;
+    size_t capacity = 0;
+      /* reclaim space used by output already written. */
+    if ((stream->skip > 0) && (stream->size+size > stream->capacity))
+    {
+        memmove(stream->queue,
+            stream->queue+stream->skip, stream->size-stream->skip);
+        stream->size -= stream->skip;
+        stream->boundary = (stream->boundary > stream->skip)?
+            stream->boundary-stream->skip : 0;
+        stream->skip = 0;
+    }
+      /* grow queue as necessary. */
+    if ( stream->size+size > stream->capacity )
+    {
+        capacity = (stream->capacity > 0)? stream->capacity : 4096;
+        while ( capacity < stream->size+size ) {
+            capacity *= 2;
+        }
+        queue = (char*)realloc(stream->queue, capacity);
+        if ( queue == 0 ) {
+            stream->error = fcgi_owire_error_out_of_memory; return;
+        }
+        stream->queue = queue;
+        stream->capacity = capacity;
+    }
+    memcpy(stream->queue+stream->size, data, size);
+    stream->size += size;
+      /* remember where the last complete exchange ends. */
+    if ( stream->more == 0 ) {
+        stream->boundary = stream->size;
+    }
+}
+
+static void _fcgi_owire_write
+    ( fcgi_owire * stream, const char * data, size_t size )
+{
+    size_t used = 0;
+      /* output was lost, don't make things worse. */
+    if ( stream->error != fcgi_owire_error_none ) {
+        return;
+    }
+      /* preserve ordering: once output is pending, queue everything. */
+    if ( stream->skip == stream->size ) {
+        used = stream->write_stream(stream, data, size);
+    }
+    if ( used < size ) {
+        _fcgi_owire_queue(stream, data+used, size-used);
+    }
+}
+
+static void _fcgi_owire_write_parts ( fcgi_owire * stream,
+    const char ** parts, const size_t * sizes, size_t count )
+{
+    size_t used = 0;
+    size_t i = 0;
+    if ( stream->error != fcgi_owire_error_none ) {
+        return;
+    }
+      /* preserve ordering: once output is pending, queue everything. */
+    if ((stream->write_parts == 0) || (stream->skip != stream->size))
+    {
+        for ( i = 0; (i < count); ++i ) {
+            _fcgi_owire_write(stream, parts[i], sizes[i]);
+        }
+        return;
+    }
+    used = stream->write_parts(stream, parts, sizes, count);
+      /* queue what the output stream did not accept. */
+    for ( i = 0; (i < count); ++i )
+    {
+        if ( used >= sizes[i] ) {
+            used -= sizes[i]; continue;
+        }
+        _fcgi_owire_queue(stream, parts[i]+used, sizes[i]-used);
+        used = 0;
+    }
+}
+
 static size_t _fcgi_owire_send ( fcgi_owire * stream,
     uint16_t rqid, int type, const char * body, size_t size )
 {
@@ -37,14 +126,139 @@ static size_t _fcgi_owire_send ( fcgi_owire * stream,
         0,                             // padding        : 0
         0,                             // reserved       : ...
     };
-    stream->write_stream(stream, head,    8);
-    stream->write_stream(stream, body, size);
+    const char * parts[2];
+    size_t sizes[2];
+    parts[0] = head; sizes[0] = 8;
+    parts[1] = body; sizes[1] = size;
+    _fcgi_owire_write_parts(stream, parts, sizes, (size > 0)? 2 : 1);
     if ( stream->flush_stream ) {
         stream->flush_stream(stream);
     }
     return (size);
 }
 
+static size_t _fcgi_owire_send_parts ( fcgi_owire * stream, uint16_t rqid,
+    int type, const char ** parts, const size_t * sizes, size_t count )
+{
+    char head[8];
+    const char * slices[16];
+    size_t lengths[16];
+    size_t slice = 0;
+    size_t part = 0;
+    size_t used = 0;
+    size_t size = 0;
+    size_t todo = 0;
+    size_t pass = 0;
+    size_t i = 0;
+    for ( i = 0; (i < count); ++i ) {
+        size += sizes[i];
+    }
+      /* content may span multiple records. */
+    i = 0;
+    do {
+        todo = _fcgi_owire_min(size-used, MAXIMUM_CONTENT_LENGTH);
+        slices[0] = head;
+        lengths[0] = fcgi_owire_head(head, rqid, type, todo);
+        slice = 1;
+          /* gather (part of) each part, in order. */
+        used += todo;
+        while ( todo > 0 )
+        {
+            pass = _fcgi_owire_min(sizes[part]-i, todo);
+            if ( pass > 0 )
+            {
+                if ( slice == 16 ) {
+                    _fcgi_owire_write_parts(stream, slices, lengths, slice);
+                    slice = 0;
+                }
+                slices[slice] = parts[part]+i;
+                lengths[slice] = pass;
+                ++slice;
+            }
+            todo -= pass;
+            if ((i += pass) == sizes[part]) {
+                ++part, i = 0;
+            }
+        }
+        _fcgi_owire_write_parts(stream, slices, lengths, slice);
+        if ( stream->flush_stream ) {
+            stream->flush_stream(stream);
+        }
+    }
+    while ( used < size );
+    return (used);
+}
+
+static size_t _fcgi_owire_send_pair ( fcgi_owire * stream, uint16_t rqid,
+    int type, const char * name, size_t nsize, const char * data, size_t dsize )
+{
+    char head[8];
+    const char * parts[3];
+    size_t sizes[3];
+    parts[0] = head; sizes[0] = fcgi_owire_pair_head(head, nsize, dsize);
+    parts[1] = name; sizes[1] = nsize;
+    parts[2] = data; sizes[2] = dsize;
+    return (_fcgi_owire_send_parts(stream, rqid, type, parts, sizes, 3));
+}
+
+static size_t _fcgi_owire_put_length ( char * head, size_t size )
+{
+      /* when length <= 127, length is only one byte. */
+    if ( size <= 127 ) {
+        head[0] = (char)size; return (1);
+    }
+    head[0] = (char)(((size>>24)&0x7f)|0x80);
+    head[1] = (char)((size>>16)&0xff);
+    head[2] = (char)((size>> 8)&0xff);
+    head[3] = (char)((size>> 0)&0xff);
+    return (4);
+}
+
+size_t fcgi_owire_head
+    ( char * head, uint16_t request, int type, size_t size )
+{
+    head[0] = 1;                          // version        : FCGI_VERSION_1
+    head[1] = (char)type;                 // record type    : ...
+    head[2] = (char)((request>>8)&0xff);  // request id     : ...
+    head[3] = (char)((request>>0)&0xff);  // (continued)
+    head[4] = (char)((size>>8)&0xff);     // content length : ...
+    head[5] = (char)((size>>0)&0xff);     // (continued)
+    head[6] = 0;                          // padding        : 0
+    head[7] = 0;                          // reserved       : ...
+    return (8);
+}
+
+size_t fcgi_owire_write
+    ( fcgi_owire * stream, const char * data, size_t size, int more )
+{
+    stream->more = more;
+    _fcgi_owire_write(stream, data, size);
+    if ( stream->flush_stream ) {
+        stream->flush_stream(stream);
+    }
+    return (size);
+}
+
+size_t fcgi_owire_pair_size ( size_t nsize, size_t dsize )
+{
+    return (((nsize <= 127)? 1 : 4) + ((dsize <= 127)? 1 : 4) + nsize + dsize);
+}
+
+size_t fcgi_owire_pair_head ( char * head, size_t nsize, size_t dsize )
+{
+    size_t used = _fcgi_owire_put_length(head, nsize);
+    return (used + _fcgi_owire_put_length(head+used, dsize));
+}
+
+size_t fcgi_owire_pair ( char * buffer,
+    const char * name, size_t nsize, const char * data, size_t dsize )
+{
+    size_t used = fcgi_owire_pair_head(buffer, nsize, dsize);
+    memcpy(buffer+used, name, nsize), used += nsize;
+    memcpy(buffer+used, data, dsize), used += dsize;
+    return (used);
+}
+
 void fcgi_owire_init
     ( const fcgi_owire_settings * settings, fcgi_owire * stream )
 {
@@ -52,7 +266,55 @@ void fcgi_owire_init
     stream->settings = settings;
     stream->object = 0;
     stream->write_stream = 0;
+    stream->write_parts = 0;
     stream->flush_stream = 0;
+    stream->more = 0;
+    stream->queue = 0;
+    stream->capacity = 0;
+    stream->size = 0;
+    stream->skip = 0;
+    stream->boundary = 0;
+}
+
+void fcgi_owire_clear ( fcgi_owire * stream )
+{
+    stream->error = fcgi_owire_error_none;
+    free(stream->queue);
+    stream->queue = 0;
+    stream->capacity = 0;
+    stream->size = 0;
+    stream->skip = 0;
+    stream->boundary = 0;
+}
+
+size_t fcgi_owire_pending ( const fcgi_owire * stream )
+{
+    return (stream->size-stream->skip);
+}
+
+size_t fcgi_owire_resume ( fcgi_owire * stream )
+{
+    if ( stream->error != fcgi_owire_error_none ) {
+        return (stream->size-stream->skip);
+    }
+      /* don't hold back the end of exchanges behind unfinished ones. */
+    if ( stream->skip < stream->boundary )
+    {
+        stream->more = 0;
+        stream->skip += stream->write_stream(stream,
+            stream->queue+stream->skip, stream->boundary-stream->skip);
+    }
+    if ( (stream->skip >= stream->boundary) && (stream->skip < stream->size) )
+    {
+        stream->more = 1;
+        stream->skip += stream->write_stream(stream,
+            stream->queue+stream->skip, stream->size-stream->skip);
+    }
+      /* rewind, but keep the buffer. */
+    if ( stream->skip == stream->size ) {
+        stream->skip = stream->size = stream->boundary = 0;
+    }
+    return (stream->size-stream->skip);
 }
 
 size_t fcgi_owire_new_request
@@ -63,11 +325,13 @@ size_t fcgi_owire_new_request
         0,                             // flags
         0, 0, 0, 0, 0,                 // reserved
     };
+    stream->more = 1;
     _fcgi_owire_send(stream, request, 1, body, 8); return (0);
 }
 
 size_t fcgi_owire_bad_request ( fcgi_owire * stream, uint16_t request )
 {
+    stream->more = 0;
     _fcgi_owire_send(stream, request, 2, 0, 0); return (0);
 }
 
@@ -80,6 +344,7 @@ size_t fcgi_owire_end_request
         pstatus,                                    // protocol status
         0, 0, 0,                                    // reserved
     };
+    stream->more = 0;
     _fcgi_owire_send(stream, request, 3, body, 8); return (0);
 }
 
@@ -87,6 +352,7 @@ size_t fcgi_owire_param
     ( fcgi_owire * stream, uint16_t request, const char * data, size_t size )
 {
     size_t used = 0;
+    stream->more = 1;
     do {
         used += _fcgi_owire_send(stream, request, 4,
             data+used, _fcgi_owire_min(size-used, MAXIMUM_CONTENT_LENGTH));
@@ -94,10 +360,18 @@ size_t fcgi_owire_param
     return (used);
 }
 
+size_t fcgi_owire_param_pair ( fcgi_owire * stream, uint16_t request,
+    const char * name, size_t nsize, const char * data, size_t dsize )
+{
+    stream->more = 1;
+    return (_fcgi_owire_send_pair(stream, request, 4, name, nsize, data, dsize));
+}
+
 size_t fcgi_owire_stdi
     ( fcgi_owire * stream, uint16_t request, const char * data, size_t size )
 {
     size_t used = 0;
+    stream->more = (size > 0);
     do {
         used += _fcgi_owire_send(stream, request, 5,
             data+used, _fcgi_owire_min(size-used, MAXIMUM_CONTENT_LENGTH));
@@ -109,6 +383,7 @@ size_t fcgi_owire_stdo
     ( fcgi_owire * stream, uint16_t request, const char * data, size_t size )
 {
     size_t used = 0;
+    stream->more = 1;
     do {
         used += _fcgi_owire_send(stream, request, 6,
             data+used, _fcgi_owire_min(size-used, MAXIMUM_CONTENT_LENGTH));
@@ -117,10 +392,27 @@ size_t fcgi_owire_stdo
     return (used);
 }
 
+size_t fcgi_owire_stdo_parts ( fcgi_owire * stream, uint16_t request,
+    const char ** parts, const size_t * sizes, size_t count )
+{
+    size_t size = 0;
+    size_t i = 0;
+    for ( i = 0; (i < count); ++i ) {
+        size += sizes[i];
+    }
+      /* an empty record would end the stream. */
+    if ( size == 0 ) {
+        return (0);
+    }
+    stream->more = 1;
+    return (_fcgi_owire_send_parts(stream, request, 6, parts, sizes, count));
+}
+
 size_t fcgi_owire_stde
     ( fcgi_owire * stream, uint16_t request, const char * data, size_t size )
 {
     size_t used = 0;
+    stream->more = 1;
     do {
         used += _fcgi_owire_send(stream, request, 7,
             data+used, _fcgi_owire_min(size-used, MAXIMUM_CONTENT_LENGTH));
@@ -133,6 +425,7 @@ size_t fcgi_owire_extra
     ( fcgi_owire * stream, uint16_t request, const char * data, size_t size )
 {
     size_t used = 0;
+    stream->more = (size > 0);
     do {
         used += _fcgi_owire_send(stream, request, 8,
             data+used, _fcgi_owire_min(size-used, MAXIMUM_CONTENT_LENGTH));
@@ -144,11 +437,27 @@ size_t fcgi_owire_extra
 size_t fcgi_owire_query
     ( fcgi_owire * stream, const char * data, uint16_t size )
 {
+    stream->more = 0;
     _fcgi_owire_send(stream, 0, 9, data, size); return (size);
 }
 
+size_t fcgi_owire_query_pair
+    ( fcgi_owire * stream, const char * name, size_t nsize )
+{
+    stream->more = 0;
+    return (_fcgi_owire_send_pair(stream, 0, 9, name, nsize, 0, 0));
+}
+
 size_t fcgi_owire_reply
     ( fcgi_owire * stream, const char * data, uint16_t size )
 {
+    stream->more = 0;
     _fcgi_owire_send(stream, 0, 10, data, size); return (size);
 }
+
+size_t fcgi_owire_reply_pair ( fcgi_owire * stream,
+    const char * name, size_t nsize, const char * data, size_t dsize )
+{
+    stream->more = 0;
+    return (_fcgi_owire_send_pair(stream, 0, 10, name, nsize, data, dsize));
+}
@@ -26,9 +26,22 @@ extern "C" {
 typedef enum fcgi_owire_error_t
 {
     fcgi_owire_error_none = 0,
+    fcgi_owire_error_out_of_memory,
 
 } fcgi_owire_error;
 
+  /*!
+   * @brief Protocol status values for @c fcgi_owire_end_request(), as named
+   *  by the FastCGI specification.
+   */
+enum
+{
+    FCGI_REQUEST_COMPLETE = 0,
+    FCGI_CANT_MPX_CONN = 1,
+    FCGI_OVERLOADED = 2,
+    FCGI_UNKNOWN_ROLE = 3
+};
+
   /*!
    * @brief Gets a human-readable description of the error.
    */
@@ -49,14 +62,19 @@ typedef struct fcgi_owire_settings_t
    * The writer is implemented as a Finite State Machine (FSM).  By itself, it
    * does not buffer any data.  As soon as the syntax is validated, all content
    * is forwarded to the client code through the callbacks.
+   *
+   * If the output stream does not accept all data (e.g. a non-blocking socket
+   * which would block), the writer queues the remainder.  All further output
+   * is queued behind it until client code calls @c fcgi_owire_resume().
    */
 typedef struct fcgi_owire_t
 {
       /*! @public
        * @brief Last error reported by the writer.
        *
-       * @warning This field should only be interpreted if @c state is set to
-       *  @c fcgi_parsing_failed.  Its value is undefined at all other times.
+       * Once this is set, output was lost and the record stream is corrupt:
+       * the writer drops all further output, and client code must close the
+       * connection.
        */
     fcgi_owire_error error;
 
@@ -74,14 +92,74 @@ typedef struct fcgi_owire_t
 
       /*!
        * @brief Callback used to write data to output stream.
+       *
+       * Returns the number of bytes accepted by the output stream, which may
+       * be less than requested.  The writer keeps the rest.
+       */
+    size_t(*write_stream)(struct fcgi_owire_t*, const char *, size_t);
+
+      /*!
+       * @brief Optional callback used to write several fragments at once
+       *  (e.g. with @c writev()).
+       *
+       * Returns the number of bytes accepted by the output stream, counting
+       * from the start of the first fragment.  The writer passes at most 16
+       * fragments at a time, and calls @c write_stream for each fragment
+       * when this is not set.
        */
-    void(*write_stream)(struct fcgi_owire_t*, const char *, size_t);
+    size_t(*write_parts)(struct fcgi_owire_t*,
+        const char **, const size_t *, size_t);
 
       /*!
        * @brief Callback used to flush output stream buffers.
+       *
+       * Called after each record.  Check @c more to tell records in the
+       * middle of an exchange from those that end it.
        */
     void(*flush_stream)(struct fcgi_owire_t*);
 
+      /*! @public
+       * @brief Non-zero while writing records known to be followed by more
+       *  records for the same exchange.
+       *
+       * Cleared when writing @c FCGI_END_REQUEST, @c FCGI_ABORT_REQUEST,
+       * management records and the end of the gateway's input streams.
+       * Socket-based output streams may use this to send with @c MSG_MORE
+       * (or keep @c TCP_CORK set) and let the kernel pack small records into
+       * full segments, pushing them out when the exchange is complete.
+       *
+       * @warning This field is provided to clients as read-only.
+       */
+    int more;
+
+      /*! @private
+       * @brief Output not yet accepted by the output stream.
+       * @invariant bytes [skip, size) are pending.
+       */
+    char * queue;
+
+      /*! @private
+       * @brief Allocated size of @c queue, in bytes.
+       */
+    size_t capacity;
+
+      /*! @private
+       * @brief End of pending output in @c queue.
+       */
+    size_t size;
+
+      /*! @private
+       * @brief Start of pending output in @c queue.
+       */
+    size_t skip;
+
+      /*! @private
+       * @brief End of the last output queued while @c more was 0.
+       * @invariant bytes [skip, boundary) complete exchanges, and are sent
+       *  without @c more by @c fcgi_owire_resume().
+       */
+    size_t boundary;
+
 } fcgi_owire;
 
   /*!
@@ -90,6 +168,30 @@ typedef struct fcgi_owire_t
 void fcgi_owire_init
     ( const fcgi_owire_settings * settings, fcgi_owire * stream );
 
+  /*!
+   * @brief Drop pending output and release the writer's resources.
+   *
+   * This function does not clear the @c object and callback fields.
+   */
+void fcgi_owire_clear ( fcgi_owire * stream );
+
+  /*!
+   * @brief Get the amount of output not yet accepted by the output stream.
+   * @return Number of bytes waiting for @c fcgi_owire_resume().
+   */
+size_t fcgi_owire_pending ( const fcgi_owire * stream );
+
+  /*!
+   * @brief Write as much pending output as the output stream accepts.
+   * @return Number of bytes still pending.
+   *
+   * Call this when the output stream becomes writable again, unless
+   * @c error is set.  Output that
+   * was queued up to the end of an exchange is written with @c more set to
+   * 0, the rest with @c more set to 1.
+   */
+size_t fcgi_owire_resume ( fcgi_owire * stream );
+
   /*!
    * @group gateway
    * @brief Reserve a request ID.
@@ -111,6 +213,58 @@ size_t fcgi_owire_bad_request
 size_t fcgi_owire_end_request ( fcgi_owire * stream,
     uint16_t request, uint32_t astatus, uint8_t pstatus );
 
+  /*!
+   * @brief Encode a record header into a caller-supplied buffer.
+   * @param head Buffer of at least 8 bytes.
+   * @param request Request ID.
+   * @param type Record type.
+   * @param size Content length, in [0, 2^16).
+   * @return Number of bytes written to @a head (always 8).
+   */
+size_t fcgi_owire_head
+    ( char * head, uint16_t request, int type, size_t size );
+
+  /*!
+   * @brief Send pre-encoded records.
+   * @param more Non-zero if more records follow for the same exchange, see
+   *  @c fcgi_owire::more.
+   *
+   * The data is forwarded as-is in a single write, then the output stream is
+   * flushed.  Use this to send records prepared with @c fcgi_owire_head().
+   */
+size_t fcgi_owire_write
+    ( fcgi_owire * stream, const char * data, size_t size, int more );
+
+  /*!
+   * @brief Compute the size of an encoded name-value pair.
+   * @param nsize Size of the name, in bytes.
+   * @param dsize Size of the value, in bytes.
+   * @return Number of bytes required to encode the pair, including the
+   *  length prefixes.
+   */
+size_t fcgi_owire_pair_size ( size_t nsize, size_t dsize );
+
+  /*!
+   * @brief Encode the length prefixes of a name-value pair.
+   * @param head Buffer of at least 8 bytes.
+   * @param nsize Size of the name, in bytes.
+   * @param dsize Size of the value, in bytes.
+   * @return Number of bytes written to @a head (2, 5 or 8).
+   *
+   * Lengths up to 127 are encoded on a single byte, longer lengths are encoded
+   * on 4 bytes with the high bit set.  Lengths must not exceed 2^31-1.
+   */
+size_t fcgi_owire_pair_head ( char * head, size_t nsize, size_t dsize );
+
+  /*!
+   * @brief Encode a name-value pair into a caller-supplied buffer.
+   * @param buffer Buffer of at least @c fcgi_owire_pair_size(nsize,dsize)
+   *  bytes.
+   * @return Number of bytes written to @a buffer.
+   */
+size_t fcgi_owire_pair ( char * buffer,
+    const char * name, size_t nsize, const char * data, size_t dsize );
+
   /*!
    * @ingroup gateway
    * @brief Send headers to the application.
@@ -118,6 +272,16 @@ size_t fcgi_owire_end_request ( fcgi_owire * stream,
 size_t fcgi_owire_param
     ( fcgi_owire * stream, uint16_t request, const char * data, size_t size );
 
+  /*!
+   * @ingroup gateway
+   * @brief Send a single header to the application.
+   *
+   * The name-value pair is encoded on the fly, without intermediate buffers.
+   * Pairs larger than a single record are split across multiple records.
+   */
+size_t fcgi_owire_param_pair ( fcgi_owire * stream, uint16_t request,
+    const char * name, size_t nsize, const char * data, size_t dsize );
+
   /*!
    * @ingroup gateway
    * @brief Send the application data it should receive on the standard input.
@@ -132,6 +296,20 @@ size_t fcgi_owire_stdi
 size_t fcgi_owire_stdo
     ( fcgi_owire * stream, uint16_t request, const char * data, size_t size );
 
+  /*!
+   * @ingroup application
+   * @brief Send the gateway output gathered from several fragments.
+   * @param parts Start of each fragment.
+   * @param sizes Size of each fragment, in bytes.
+   * @param count Number of fragments.
+   *
+   * Fragments are encoded back to back in as few records as possible, without
+   * intermediate buffers.  Nothing is sent if all fragments are empty, so
+   * this never ends the stream.
+   */
+size_t fcgi_owire_stdo_parts ( fcgi_owire * stream, uint16_t request,
+    const char ** parts, const size_t * sizes, size_t count );
+
   /*!
    * @ingroup application
    * @brief Send the gateway data it should receive on the standard input.
@@ -153,6 +331,13 @@ size_t fcgi_owire_extra
 size_t fcgi_owire_query
     ( fcgi_owire * stream, const char * data, uint16_t size );
 
+  /*!
+   * @ingroup gateway
+   * @brief Request a single variable from the application.
+   */
+size_t fcgi_owire_query_pair
+    ( fcgi_owire * stream, const char * name, size_t nsize );
+
   /*!
    * @ingroup application
    * @brief Send gateway a responsea to a request.
@@ -160,6 +345,13 @@ size_t fcgi_owire_query
 size_t fcgi_owire_reply
     ( fcgi_owire * stream, const char * data, uint16_t size );
 
+  /*!
+   * @ingroup application
+   * @brief Send gateway the value of a single variable.
+   */
+size_t fcgi_owire_reply_pair ( fcgi_owire * stream,
+    const char * name, size_t nsize, const char * data, size_t dsize );
+
 #ifdef __cplusplus
 }
 #endif
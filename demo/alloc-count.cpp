@@ -0,0 +1,108 @@
+// Copyright(c) Andre Caron <andre.l.caron@gmail.com>, 2011
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file alloc-count.cpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief Checks that steady-state requests don't use the global heap.
+ *
+ * Replaces the global allocation functions with counting versions, warms
+ * up the application with a few requests, then fails if handling more of
+ * the same requests allocates anything.
+ */
+
+#include <fcgi.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+
+namespace {
+
+    std::size_t allocations = 0;
+
+    class Sink :
+        public fcgi::Application
+    {
+        /* overrides. */
+    protected:
+        virtual size_t asend ( const char *, size_t size )
+        {
+            return (size);
+        }
+
+        virtual void end_of_head ( fcgi::Request& request )
+        {
+              // look up a header, as most handlers do.
+            if ( request.head().get("HTTP_HOST").empty() ) {
+                std::abort();
+            }
+        }
+
+        virtual void end_of_body ( fcgi::Request& request )
+        {
+            static const std::string status("Status: 204 No Content\r\n\r\n");
+            output(request, status);
+            output(request);
+            end_request(request);
+        }
+    };
+
+      // typical browser request, with a body.
+    std::string fixture ()
+    {
+        fcgi::Records records = fcgi::Records().new_request(1);
+        records.param("HTTP_HOST", "localhost");
+        for ( int i = 0; (i < 40); ++i )
+        {
+            std::ostringstream name;
+            name << "HTTP_X_HEADER_NUMBER_" << i;
+            records.param(name.str(), std::string(40+i, 'v'));
+        }
+        records.param().stdi(std::string(1000, 'b')).stdi();
+        std::string data(records.size(), '\0');
+        records.copy(&data[0], 1);
+        return (data);
+    }
+
+}
+
+void * operator new ( std::size_t size )
+{
+    ++allocations;
+    void *const data = std::malloc((size == 0)? 1 : size);
+    if ( data == 0 ) {
+        throw (std::bad_alloc());
+    }
+    return (data);
+}
+
+void operator delete ( void * data ) noexcept
+{
+    std::free(data);
+}
+
+int main ( int, char ** )
+{
+    const std::string data = ::fixture();
+    Sink application;
+      // let buffers reach their high-water mark.
+    for ( int i = 0; (i < 3); ++i ) {
+        application.afeed(data);
+    }
+    const std::size_t before = allocations;
+    for ( int i = 0; (i < 1000); ++i ) {
+        application.afeed(data);
+    }
+    const std::size_t count = allocations - before;
+    std::cout
+        << "Allocations for 1000 requests: " << count << "."
+        << std::endl;
+    return ((count == 0)? EXIT_SUCCESS : EXIT_FAILURE);
+}
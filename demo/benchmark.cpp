@@ -0,0 +1,115 @@
+// Copyright(c) Andre Caron <andre.l.caron@gmail.com>, 2011
+//
+// This document is covered by the an Open Source Initiative approved license. A
+// copy of the license should have been provided alongside this software package
+// (see "LICENSE.txt"). If not, terms of the license are available online at
+// "http://www.opensource.org/licenses/mit".
+
+/*!
+ * @file benchmark.cpp
+ * @author Andre Caron (andre.l.caron@gmail.com)
+ * @brief Request dispatch throughput with multiplexed request IDs.
+ */
+
+#include <fcgi.hpp>
+
+#include <ctime>
+#include <iostream>
+#include <string>
+
+namespace {
+
+    class Sink :
+        public fcgi::Application
+    {
+        /* data. */
+    private:
+        size_t myCompleted;
+
+        /* construction. */
+    public:
+        Sink ()
+            : myCompleted(0)
+        {}
+
+        /* methods. */
+    public:
+        size_t completed () const
+        {
+            return (myCompleted);
+        }
+
+        /* overrides. */
+    protected:
+        virtual size_t asend ( const char * data, size_t size )
+        {
+            return (size);
+        }
+
+        virtual void end_of_head ( fcgi::Request& request )
+        {
+        }
+
+        virtual void end_of_body ( fcgi::Request& request )
+        {
+            Application::output("Status: 204 No Content\r\n\r\n");
+            Application::output();
+            Application::end_request();
+            ++myCompleted;
+        }
+    };
+
+      // append [records] once for each ID in [1, count].
+    void interleave
+        ( std::string& data, const fcgi::Records& records, size_t count )
+    {
+        for ( size_t id = 1; (id <= count); ++id )
+        {
+            const size_t used = data.size();
+            data.resize(used+records.size());
+            records.copy(&data[used], id);
+        }
+    }
+
+      // all requests start before any of them completes.
+    std::string session ( size_t count )
+    {
+        std::string data;
+        interleave(data, fcgi::Records().new_request(1), count);
+        interleave(data, fcgi::Records()
+            .param("REQUEST_METHOD", "GET")
+            .param("SCRIPT_NAME", "/benchmark"), count);
+        interleave(data, fcgi::Records().param(), count);
+        interleave(data, fcgi::Records().stdi(), count);
+        return (data);
+    }
+
+    void run ( size_t count, size_t total )
+    {
+        const std::string data = session(count);
+        const size_t rounds = (total + count - 1) / count;
+        Sink application;
+        const std::clock_t start = std::clock();
+        for ( size_t i = 0; (i < rounds); ++i ) {
+            application.afeed(data);
+        }
+        const double elapsed =
+            double(std::clock() - start) / double(CLOCKS_PER_SEC);
+        std::cout
+            << count << " concurrent ID(s): "
+            << application.completed() << " requests in "
+            << elapsed << "s ("
+            << (elapsed > 0.0? application.completed()/elapsed : 0.0)
+            << " requests/s)."
+            << std::endl;
+    }
+
+}
+
+int main ( int, char ** )
+{
+    const size_t total = 1000000;
+    ::run(   1, total);
+    ::run(  16, total);
+    ::run(1024, total);
+}
@@ -14,80 +14,28 @@
 #include <fcgi.h>
 #include <fcgi.hpp>
 
+#include <atomic>
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
+#include <mutex>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace {
 
-    const char DATA1[] =
+    const fcgi::Records& fixture ()
     {
-        // head.
-        1,    // version       : FCGI_VERSION_1
-        1,    // type          : FCGI_BEGIN_REQUEST
-        0, 1, // request id    : 1
-        0, 1, // content length: 8
-        0,    // padding       : 0
-        0,    // reserved      : ...
-
-        // body.
-        0, 1,          // role : FCGI_RESPONDER
-        0,             // flags: 0
-        0, 0, 0, 0, 0, // reserved: ...
-    };
-    const size_t SIZE1 = sizeof(DATA1);
-
-    const char DATA2[] =
-    {
-        // head.
-        1,    // version       : FCGI_VERSION_1
-        2,    // type          : FCGI_ABORT_REQUEST
-        0, 1, // request id    : 1
-        0, 0, // content length: 0
-        0,    // padding       : 1
-        0,    // reserved      : ...
-        
-        // body.
-        //0,
-    };
-    const size_t SIZE2 = sizeof(DATA2);
-
-    const char DATA3[] =
-    {
-        // head.
-        1,     // version       : FCGI_VERSION_1
-        5,     // type          : FCGI_STDIN
-        0,  1, // request id    : 1
-        0, 12, // content length: 12
-        0,     // padding       : 0
-        0,     // reserved      : ...
-        
-        // body,
-        'h', 'e', 'l', 'l', 'o', ' ', 'w', 'o', 'r', 'l', 'd', '!',
-    };
-    const size_t SIZE3 = sizeof(DATA3)-1;
-
-    const char DATA4[] =
-    {
-        // head.
-        1,     // version       : FCGI_VERSION_1
-        4,     // type          : FCGI_PARAM
-        0,  1, // request id    : 1
-        0, 15, // content length: 15
-        9,     // padding       : 9
-        0,     // reserved      : ...
-        
-        // body,
-        11, // name length: 11
-         2, // data length:  2
-        'S','E','R','V','E','R','_','P','O','R','T', // name.
-        '8','0',                                     // data.
-        
-        // pads.
-        0, 0, 0, 0, 0, 0, 0, 0, 0,
-    };
-    const size_t SIZE4 = sizeof(DATA4);
+        static const fcgi::Records records = fcgi::Records()
+            .new_request(1) // FCGI_RESPONDER
+            .bad_request()
+            .stdi("hello world!")
+            .param("SERVER_PORT", "80")
+            .stdi("hello world!");
+        return (records);
+    }
 
     void accept_record
         ( ::fcgi_iwire * stream, int version, int request, int content )
@@ -168,11 +116,12 @@ namespace {
         }
     }
 
-    void write_stream ( fcgi_owire * stream, const char * data, size_t size )
+    size_t write_stream ( fcgi_owire * stream, const char * data, size_t size )
     {
         for ( size_t i = 0; (i < size); ++i ) {
             std::cout << int(data[i]) << ", ";
         }
+        return (size);
     }
 
     void flush_stream ( fcgi_owire * stream )
@@ -180,6 +129,131 @@ namespace {
         std::cout << std::endl;
     }
 
+        // Number of failed checks, see main().
+    int failures = 0;
+
+    void check ( bool condition, const char * message )
+    {
+        if ( !condition )
+        {
+            std::cerr << "   - " << message << "." << std::endl;
+            ++failures;
+        }
+    }
+
+        // Records as sent by the gateway for request [id].
+    std::string encode ( const fcgi::Records& records, uint16_t id )
+    {
+        std::string data(records.size(), '\0');
+        records.copy(&data[0], id);
+        return (data);
+    }
+
+        // GET request for [path], as most gateways send it.
+    fcgi::Records get ( const std::string& path )
+    {
+        return (fcgi::Records().new_request(1)
+            .param("REQUEST_METHOD", "GET")
+            .param("SCRIPT_NAME", path)
+            .param().stdi());
+    }
+
+        // Responder that counts handler calls, and may hold requests.
+    class Handler :
+        public fcgi::Responder
+    {
+        /* data. */
+    public:
+        std::string sent;
+        int calls;
+        std::string status;
+        bool hold;
+        std::vector<fcgi::Request*> held;
+        bool coalescing;
+
+        /* construction. */
+    public:
+        Handler ()
+            : calls(0), status("200 OK"), hold(false), coalescing(false)
+        {}
+
+        /* methods. */
+    public:
+        void finish ()
+        {
+            for ( size_t i = 0; (i < held.size()); ++i ) {
+                respond(*held[i]);
+            }
+            held.clear();
+        }
+
+    private:
+        void respond ( fcgi::Request& request )
+        {
+            std::ostringstream response;
+            response << "Status: " << status << "\r\n\r\nv" << calls;
+            Application::output(request, response.str());
+            Application::output(request);
+            Application::end_request(request);
+        }
+
+        /* application. */
+    protected:
+        virtual size_t asend ( const char * data, size_t size )
+        {
+            sent.append(data, size);
+            return (size);
+        }
+
+        virtual std::string flight ( const fcgi::Request& request )
+        {
+            return (coalescing? request.head().get("SCRIPT_NAME") : "");
+        }
+
+        virtual void handle_request ( fcgi::Request& request )
+        {
+            ++calls;
+            if ( hold ) {
+                held.push_back(&request);
+            }
+            else {
+                respond(request);
+            }
+        }
+    };
+
+        // Describe (then drop) the records in [output], skipping empty ones:
+        // "id:body" for standard output, without the response headers, and
+        // "id!status" for the end of request, with its protocol status.
+    std::string summary ( std::string& output )
+    {
+        std::ostringstream summary;
+        const unsigned char *const data =
+            reinterpret_cast<const unsigned char*>(output.data());
+        for ( std::size_t i = 0; (i+8 <= output.size()); )
+        {
+            const int type = data[i+1];
+            const int request = (data[i+2] << 8) | data[i+3];
+            const std::size_t size = (data[i+4] << 8) | data[i+5];
+            std::string content = output.substr(i+8, size);
+            if ( (type == ::fcgi_iwire_record_stdo) && (size > 0) )
+            {
+                const std::string::size_type end = content.find("\r\n\r\n");
+                if ( end != std::string::npos ) {
+                    content.erase(0, end+4);
+                }
+                summary << ' ' << request << ':' << content;
+            }
+            if ( type == ::fcgi_iwire_record_done ) {
+                summary << ' ' << request << '!' << int(data[i+12]);
+            }
+            i += 8 + size + data[i+6];
+        }
+        output.clear();
+        const std::string result = summary.str();
+        return (result.empty()? result : result.substr(1));
+    }
+
 }
 
 void iwire_test ()
@@ -193,15 +267,14 @@ void iwire_test ()
     stream.finish_record       = &::finish_record;
     stream.accept_request      = &::accept_request;
     stream.cancel_request      = &::cancel_request;
-    //stream.accept_headers      = &::accept_headers;
+    stream.accept_headers      = &::accept_param_data;
     //stream.finish_headers      = &::finish_headers;
     stream.accept_content_stdi = &::accept_content_stdi;
         // Feed multiple requests.
-    ::feed(&stream, DATA1, SIZE1);
-    ::feed(&stream, DATA2, SIZE2);
-    ::feed(&stream, DATA3, SIZE3);
-    ::feed(&stream, DATA4, SIZE4);
-    ::feed(&stream, DATA3, SIZE3);
+    const fcgi::Records& records = ::fixture();
+    std::string data(records.size(), '\0');
+    records.copy(&data[0], 1);
+    ::feed(&stream, data.data(), data.size());
 }
 
 void owire_test ()
@@ -224,8 +297,6 @@ void owire_test ()
       ::fcgi_owire_stdi(&stream, 1, data, sizeof(data)-1); }
 }
 
-#include <sstream>
-
 std::string ostream_request ()
 {
     std::ostringstream buffer;
@@ -389,7 +460,392 @@ void advanced_test ()
     test.Gateway::body();
 }
 
+void rope_test ()
+{
+    class Test :
+        public fcgi::Application
+    {
+        /* data. */
+    public:
+        std::string sent;
+        std::string content;
+        std::string body;
+        std::size_t slices;
+        std::string tail;
+
+        /* application. */
+    protected:
+        virtual size_t asend ( const char * data, size_t size )
+        {
+            sent.append(data, size);
+            return (size);
+        }
+
+        virtual void end_of_head ( fcgi::Request& request )
+        {
+        }
+
+        virtual void end_of_body ( fcgi::Request& request )
+        {
+            const fcgi::Rope& rope = request.rope();
+            content = rope.flatten();
+            body = request.body();
+            slices = rope.slices();
+#ifndef _WIN32
+              // skip the first slice and part of the second.
+            ::iovec vectors[4];
+            const size_t count = rope.iovecs(vectors, 4, 7);
+            for ( size_t i = 0; (i < count); ++i )
+            {
+                tail.append(static_cast<const char*>(vectors[i].iov_base),
+                            vectors[i].iov_len);
+            }
+#endif
+            Application::output(request, "done");
+            Application::output(request);
+            Application::end_request(request);
+        }
+    };
+
+      // split the body across two receive buffers.
+    std::string head = ::encode(fcgi::Records()
+        .new_request(1).param().stdi("hello"), 1);
+    std::string tail = ::encode(fcgi::Records()
+        .stdi(" rope").stdi(), 1);
+    const fcgi::Buffer first(head);
+    const fcgi::Buffer second(tail);
+
+    Test test;
+    test.rope(true);
+    test.afeed(first);
+    ::check(!first.unique(), "rope doesn't refer to the receive buffer");
+    test.afeed(second);
+    ::check(test.content == "hello rope", "rope content mismatch");
+    ::check(test.body.empty(), "rope content copied to the body");
+    ::check(test.slices == 2, "rope content was copied");
+#ifndef _WIN32
+    ::check(test.tail == "ope", "rope vectors mismatch");
+#endif
+    ::check(::summary(test.sent) == "1:done 1!0", "rope response mismatch");
+      // ending the request releases the buffers.
+    ::check(first.unique() && second.unique(), "rope buffers leaked");
+}
+
+void cache_test ()
+{
+    { // fresh entries are replayed, per path.
+        fcgi::Cache cache(60);
+        ::Handler test;
+        test.cache(&cache);
+        test.afeed(::encode(::get("/a"), 1));
+        test.afeed(::encode(::get("/a"), 2));
+        test.afeed(::encode(::get("/b"), 3));
+        ::check(::summary(test.sent) == "1:v1 1!0 2:v1 2!0 3:v2 3!0",
+                "cache didn't replay a fresh entry");
+        ::check(test.calls == 2, "cache ran the handler for a fresh entry");
+          // only successful responses are stored.
+        test.status = "500 Internal Server Error";
+        test.afeed(::encode(::get("/c"), 1));
+        test.afeed(::encode(::get("/c"), 1));
+        ::check(test.calls == 4, "cache stored an error");
+        ::check(cache.size() == 2, "cache size mismatch");
+    }
+    { // stale entries are replayed while one request refreshes them.
+        fcgi::Cache cache(0, 60);
+        ::Handler test;
+        test.cache(&cache);
+        test.afeed(::encode(::get("/a"), 1));
+        test.hold = true;
+        test.afeed(::encode(::get("/a"), 2));
+        test.afeed(::encode(::get("/a"), 3));
+        ::check(::summary(test.sent) == "1:v1 1!0 3:v1 3!0",
+                "cache didn't replay a stale entry");
+        ::check(test.calls == 2, "cache refreshed an entry twice");
+        test.finish();
+        ::check(::summary(test.sent) == "2:v2 2!0",
+                "cache refresh response mismatch");
+        test.afeed(::encode(::get("/a"), 4));
+        test.afeed(::encode(::get("/a"), 5));
+        test.finish();
+        ::check(::summary(test.sent) == "5:v2 5!0 4:v3 4!0",
+                "cache didn't store the refreshed entry");
+    }
+    { // expired entries are regenerated.
+        fcgi::Cache cache(0, 0);
+        ::Handler test;
+        test.cache(&cache);
+        test.afeed(::encode(::get("/a"), 1));
+        test.afeed(::encode(::get("/a"), 2));
+        ::check(::summary(test.sent) == "1:v1 1!0 2:v2 2!0",
+                "cache replayed an expired entry");
+    }
+      // private responses are never shared.
+    ::check(fcgi::Cache::cacheable(fcgi::Records()
+        .stdo("Content-Type: text/plain\r\n\r\nx").stdo().end_request()),
+        "cache refused a public response");
+    ::check(!fcgi::Cache::cacheable(fcgi::Records()
+        .stdo("Set-Cookie: a=b\r\n\r\nx").stdo().end_request()),
+        "cache accepted a response that sets a cookie");
+    ::check(!fcgi::Cache::cacheable(fcgi::Records()
+        .stdo("Cache-Control: private\r\n\r\nx").stdo().end_request()),
+        "cache accepted a private response");
+    ::check(!fcgi::Cache::cacheable(fcgi::Records()
+        .stdo("Status: 200 OK\r\n\r\nx").stdo().end_request(1)),
+        "cache accepted a failed request");
+}
+
+void coalesce_test ()
+{
+    { // waiters receive the leader's output.
+        ::Handler test;
+        test.coalescing = true;
+        test.hold = true;
+        test.afeed(::encode(::get("/a"), 1));
+        test.afeed(::encode(::get("/a"), 2));
+        test.afeed(::encode(fcgi::Records().new_request(1)
+            .param("REQUEST_METHOD", "HEAD")
+            .param("SCRIPT_NAME", "/a")
+            .param().stdi(), 3));
+        test.afeed(::encode(::get("/b"), 4));
+        ::check(test.calls == 3, "coalescing ran the handler for a waiter");
+        test.finish();
+        ::check(::summary(test.sent) ==
+                "1:v3 1!0 2:v3 2!0 3:v3 3!0 4:v3 4!0",
+                "coalescing didn't replay the leader's output");
+    }
+    { // the next waiter takes over when the gateway aborts the leader.
+        ::Handler test;
+        test.coalescing = true;
+        test.hold = true;
+        test.afeed(::encode(::get("/a"), 1));
+        test.afeed(::encode(::get("/a"), 2));
+        test.afeed(::encode(::get("/a"), 3));
+        test.afeed(::encode(fcgi::Records().bad_request(), 1));
+        ::check(test.calls == 2, "coalescing didn't promote a waiter");
+          // the application already ended the aborted request.
+        test.held.erase(test.held.begin());
+        test.finish();
+        ::check(::summary(test.sent) == "1!0 2:v2 2!0 3:v2 3!0",
+                "coalescing didn't replay the new leader's output");
+    }
+    { // connections sharing flights coalesce their requests.
+        fcgi::Flights flights;
+        ::Handler first;
+        ::Handler second;
+        first.coalescing = second.coalescing = true;
+        first.hold = second.hold = true;
+        first.flights(&flights);
+        second.flights(&flights);
+        first.afeed(::encode(::get("/a"), 1));
+        second.afeed(::encode(::get("/a"), 1));
+        ::check(second.calls == 0, "coalescing ignored shared flights");
+        first.finish();
+        ::check(::summary(first.sent) == "1:v1 1!0",
+                "coalescing leader response mismatch");
+        ::check(::summary(second.sent) == "1:v1 1!0",
+                "coalescing didn't replay across connections");
+    }
+}
+
+void priority_test ()
+{
+    class Step :
+        public fcgi::Job
+    {
+        /* data. */
+    private:
+        std::string& myOrder;
+        char myName;
+
+        /* construction. */
+    public:
+        Step ( std::string& order, char name, int priority, double deadline )
+            : myOrder(order), myName(name)
+        {
+            Job::priority(priority);
+            Job::deadline(deadline);
+        }
+
+        /* job. */
+    public:
+        virtual void execute ()
+        {
+            myOrder += myName;
+        }
+
+        virtual void complete ()
+        {
+        }
+    };
+
+      // holds the pool's only thread until the test opens the gate.
+    class Gate :
+        public fcgi::Job
+    {
+        /* data. */
+    private:
+        std::mutex& myLock;
+        std::atomic<bool>& myStarted;
+
+        /* construction. */
+    public:
+        Gate ( std::mutex& lock, std::atomic<bool>& started )
+            : myLock(lock), myStarted(started)
+        {}
+
+        /* job. */
+    public:
+        virtual void execute ()
+        {
+            myStarted = true;
+            std::lock_guard<std::mutex> guard(myLock);
+        }
+
+        virtual void complete ()
+        {
+        }
+    };
+
+      // only the pool's thread writes, read it once the pool stopped.
+    std::string order;
+    {
+        std::mutex lock;
+        std::atomic<bool> started(false);
+        fcgi::PriorityPool pool(1);
+        lock.lock();
+        pool.submit(new Gate(lock, started));
+        while ( !started ) {
+            std::this_thread::yield();
+        }
+        const double now = fcgi::Job::now();
+        pool.submit(new Step(order, 'a',  0, 0.0));
+        pool.submit(new Step(order, 'b',  0, now+60.0));
+        pool.submit(new Step(order, 'c',  0, now+30.0));
+        pool.submit(new Step(order, 'd',  5, 0.0));
+        pool.submit(new Step(order, 'e', -1, 0.0));
+        pool.submit(new Step(order, 'x',  0, now-1.0));
+        lock.unlock();
+    }
+    ::check(order == "dcbae", "priority pool order mismatch");
+
+      // requests past their deadline are refused without running them.
+    ::Handler test;
+    test.deadline_header("HTTP_X_REQUEST_DEADLINE");
+    test.afeed(::encode(fcgi::Records().new_request(1)
+        .param("HTTP_X_REQUEST_DEADLINE", "1")
+        .param().stdi(), 1));
+    test.afeed(::encode(fcgi::Records().new_request(1)
+        .param("HTTP_X_REQUEST_DEADLINE", "nan")
+        .param().stdi(), 2));
+    ::check(test.calls == 1, "deadline check ran an expired request");
+    ::check(test.sent.find("Status: 503") != std::string::npos,
+            "deadline check didn't refuse an expired request");
+    ::check(::summary(test.sent) == "1: 1!0 2:v1 2!0",
+            "deadline check response mismatch");
+}
+
+void admission_test ()
+{
+    fcgi::Admission admission(0.005, 0.100);
+      // short bursts are absorbed.
+    admission.sample(0.001, 0.00);
+    admission.sample(0.010, 1.00);
+    admission.sample(0.010, 1.05);
+    ::check(!admission.overloaded(), "admission refused a burst");
+    ::check(admission.admit(1.05), "admission refused during a burst");
+      // a whole interval above target starts refusing requests, at
+      // intervals shrinking with the square root of the refusal count.
+    admission.sample(0.010, 1.10);
+    ::check(admission.overloaded(), "admission ignored overload");
+    ::check(!admission.admit(1.10), "admission accepted under overload");
+    ::check(admission.admit(1.15), "admission refused too soon (1)");
+    ::check(!admission.admit(1.18), "admission missed a refusal (1)");
+    ::check(admission.admit(1.23), "admission refused too soon (2)");
+    ::check(!admission.admit(1.24), "admission missed a refusal (2)");
+    ::check(admission.admit(1.28), "admission refused too soon (3)");
+      // accepts everything as soon as the delay drops.
+    admission.sample(0.001, 1.30);
+    ::check(!admission.overloaded(), "admission didn't recover");
+    ::check(admission.admit(1.30), "admission refused after recovery");
+      // overload coming back soon resumes close to the previous rate.
+    admission.sample(0.010, 1.40);
+    admission.sample(0.010, 1.50);
+    ::check(!admission.admit(1.50), "admission accepted under overload");
+    ::check(admission.admit(1.55), "admission refused too soon (4)");
+    ::check(!admission.admit(1.56), "admission missed a refusal (3)");
+
+      // refused requests end with FCGI_OVERLOADED, without a handler.
+    fcgi::Admission overloaded(0.005, 0.100);
+    const double now = fcgi::Job::now();
+    overloaded.sample(1.0, now-1.0);
+    overloaded.sample(1.0, now);
+    ::Handler test;
+    test.admission(&overloaded);
+    test.afeed(::encode(::get("/a"), 1));
+    ::check(test.calls == 0, "admission ran a refused request");
+    ::check(::summary(test.sent) == "1!2",
+            "admission didn't answer with FCGI_OVERLOADED");
+}
+
+void batch_test ()
+{
+    class Test :
+        public ::Handler
+    {
+        /* data. */
+    public:
+        std::string sizes;
+
+        /* application. */
+    protected:
+        virtual void handle_batch
+            ( fcgi::Request * const * requests, size_t count )
+        {
+            std::ostringstream size;
+            size << count;
+            sizes += size.str();
+            Handler::handle_batch(requests, count);
+        }
+    };
+
+    const fcgi::Records head = fcgi::Records().new_request(1).param();
+    const fcgi::Records tail = fcgi::Records().stdi();
+
+    { // full batches are handed over right away, the rest at the end.
+        Test test;
+        test.batch(2);
+        test.afeed(::encode(head, 1) + ::encode(head, 2) + ::encode(head, 3));
+        ::check(test.sizes == "21", "batch sizes mismatch");
+        test.afeed(::encode(tail, 1) + ::encode(tail, 2) + ::encode(tail, 3));
+        ::check(::summary(test.sent) == "1:v1 1!0 2:v2 2!0 3:v3 3!0",
+                "batch responses mismatch");
+    }
+    { // body content hands the batch over first.
+        Test test;
+        test.batch(8);
+        test.afeed(::encode(fcgi::Records(head).stdi("x").stdi(), 1)
+                 + ::encode(head, 2));
+        ::check(test.sizes == "11", "batch held requests with a body");
+        ::check(::summary(test.sent) == "1:v1 1!0",
+                "batch response mismatch");
+    }
+    { // not batching.
+        Test test;
+        test.afeed(::encode(head, 1) + ::encode(tail, 1));
+        ::check(test.sizes.empty(), "batch used when disabled");
+        ::check(::summary(test.sent) == "1:v1 1!0",
+                "batch response mismatch");
+    }
+}
+
 int main ( int, char ** )
 {
     advanced_test();
+    rope_test();
+    cache_test();
+    coalesce_test();
+    priority_test();
+    admission_test();
+    batch_test();
+    return ((::failures == 0)? EXIT_SUCCESS : EXIT_FAILURE);
 }
@@ -8,15 +8,23 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <netinet/in.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <string.h>
 #include <unistd.h>
+#ifdef SO_ZEROCOPY
+#   include <linux/errqueue.h>
+#endif
 
 #include <cstdlib>
+#include <deque>
 #include <iostream>
 #include <set>
+#include <utility>
 
 namespace fcgi { namespace nix {
 
@@ -30,56 +38,213 @@ namespace fcgi { namespace nix {
     class Session :
         public ::Application
     {
+        /* nested types. */
+    private:
+        typedef std::pair<uint32_t, fcgi::Buffer> Transfer;
+
         /* data. */
     private:
         int myStream;
+        int myWakeup;
+
+        // buffers sent with MSG_ZEROCOPY, by send sequence number.
+        bool myZeroCopy;
+        uint32_t mySequence;
+        std::deque<Transfer> myTransfers;
 
         /* construction. */
     public:
         /*!
          * @brief Create a session.
          * @param stream TCP stream socket file descriptor.
+         * @param workers Number of worker processes accepting connections.
+         * @param threads Thread pool running handlers.
+         * @param wakeup Pipe to write to when handlers complete.
          */
-        Session (int stream)
-            : myStream(stream)
-        {}
+        Session (int stream, std::size_t workers,
+                 fcgi::Executor& threads, int wakeup)
+            : myStream(stream), myWakeup(wakeup),
+              myZeroCopy(false), mySequence(0)
+        {
+            executor(&threads);
+            // tell the gateway how many connections and requests to open.
+            const std::size_t requests = concurrent_requests();
+            limits(workers, workers*requests, requests > 1);
+#ifdef SO_ZEROCOPY
+            const int enable = 1;
+            myZeroCopy = (::setsockopt(myStream, SOL_SOCKET, SO_ZEROCOPY,
+                                       &enable, sizeof(enable)) == 0);
+#endif
+        }
+
+        /* class methods. */
+    public:
+        /*!
+         * @brief Obtain the smallest payload sent with @c MSG_ZEROCOPY.
+         *
+         * Page pinning and completion notifications cost more than copying
+         * small payloads, so those are always copied.
+         */
+        static size_t zerocopy_threshold () {
+            return (16*1024);
+        }
 
         /* methods. */
+    private:
+        int flags () const
+        {
+            return (more()? MSG_MORE : 0);
+        }
+
     public:
-        void feed (const char * data, size_t size)
+        void feed (const fcgi::Buffer& buffer)
+        {
+            // parse received record(s), body content may refer to buffer.
+            afeed(buffer);
+        }
+
+        /*!
+         * @brief Check for buffers still referenced by the kernel.
+         */
+        bool transfers () const
         {
-            // parse received record(s).
-            afeed(data, size);
+            return (!myTransfers.empty());
+        }
+
+        /*!
+         * @brief Release buffers the kernel is done sending.
+         * @return @c true if any completion notification was received.
+         */
+        bool reap ()
+        {
+            bool reaped = false;
+#ifdef SO_ZEROCOPY
+            while (!myTransfers.empty())
+            {
+                char control[128];
+                ::msghdr message;
+                ::memset(&message, 0, sizeof(message));
+                message.msg_control = control;
+                message.msg_controllen = sizeof(control);
+                if (::recvmsg(myStream, &message, MSG_ERRQUEUE) < 0) {
+                    break;
+                }
+                reaped = true;
+                ::cmsghdr * header = CMSG_FIRSTHDR(&message);
+                for (; header; header = CMSG_NXTHDR(&message, header))
+                {
+                    const ::sock_extended_err * error =
+                        (const ::sock_extended_err*)CMSG_DATA(header);
+                    if ((error->ee_errno != 0) ||
+                        (error->ee_origin != SO_EE_ORIGIN_ZEROCOPY)) {
+                        continue;
+                    }
+                    // sends [ee_info, ee_data] are complete.
+                    const uint32_t first = error->ee_info;
+                    const uint32_t count = error->ee_data-first;
+                    std::deque<Transfer>::iterator transfer =
+                        myTransfers.begin();
+                    while (transfer != myTransfers.end())
+                    {
+                        if ((transfer->first-first) <= count) {
+                            transfer = myTransfers.erase(transfer);
+                        }
+                        else {
+                            ++transfer;
+                        }
+                    }
+                }
+            }
+#endif
+            return (reaped);
         }
 
         /* overrides. */
     protected:
-        virtual void asend (const char * data, size_t size)
+        virtual void wake ()
+        {
+            // the I/O thread polls the other end of the pipe.
+            const char signal = 0;
+            while ((::write(myWakeup, &signal, 1) < 0) && (errno == EINTR)) {
+            }
+        }
+
+        virtual size_t asend (const char * data, size_t size)
         {
-            // push received data.
-            ssize_t sent = 0;
-            ssize_t pass = 0;
-            while ((pass=::send(myStream,data+sent,size-sent,0)) > 0) {
-                sent += pass;
+            // push as much as the socket takes without blocking, the
+            // rest stays queued until the socket is writable again.  Let
+            // the kernel coalesce records until the response is complete.
+            const ssize_t sent = ::send(myStream, data, size,
+                                        MSG_DONTWAIT|MSG_NOSIGNAL|flags());
+            if (sent >= 0) {
+                return (sent);
             }
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK) ||
+                (errno == EINTR)) {
+                return (0);
+            }
+
+            // connection is broken, drop output.
+            std::cout
+                << "[" << ::getpid() << "] "
+                << "Failed to send: '" << ::strerror(errno) << "'."
+                << std::endl;
+            return (size);
+        }
 
-            // confirm that we were able to send everything.
-            if (sent != size)
+        virtual size_t asend
+            (const char ** parts, const size_t * sizes, std::size_t count)
+        {
+            // gather record headers and content in a single system call.
+            ::iovec vectors[16];
+            ::msghdr message;
+            ::memset(&message, 0, sizeof(message));
+            std::size_t size = 0;
+            for (std::size_t i = 0; (i < count) && (i < 16); ++i)
             {
-                std::cout
-                    << "[" << ::getpid() << "] "
-                    << "Failed to echo entire packet."
-                    << std::endl;
+                vectors[i].iov_base = const_cast<char*>(parts[i]);
+                vectors[i].iov_len = sizes[i];
+                message.msg_iovlen = i+1;
+                size += sizes[i];
+            }
+            message.msg_iov = vectors;
+            const ssize_t sent = ::sendmsg(myStream, &message,
+                                           MSG_DONTWAIT|MSG_NOSIGNAL|flags());
+            if (sent >= 0) {
+                return (sent);
+            }
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK) ||
+                (errno == EINTR)) {
+                return (0);
             }
+
+            // connection is broken, drop output.
+            std::cout
+                << "[" << ::getpid() << "] "
+                << "Failed to send: '" << ::strerror(errno) << "'."
+                << std::endl;
+            return (size);
         }
 
-        virtual void query
-            (const std::string& name, const std::string& data)
+        virtual size_t asend
+            (const fcgi::Buffer& buffer, size_t offset, size_t size)
         {
-            // ...
-            if (concurrent_requests() > 0)
+#ifdef SO_ZEROCOPY
+            if (myZeroCopy && (size >= zerocopy_threshold()))
             {
+                const ssize_t sent = ::send(
+                    myStream, buffer.data()+offset, size,
+                    MSG_ZEROCOPY|MSG_DONTWAIT|MSG_NOSIGNAL|flags());
+                if (sent > 0)
+                {
+                    // the kernel uses the buffer until it notifies us.
+                    myTransfers.push_back(Transfer(mySequence++, buffer));
+                    return (sent);
+                }
             }
+#endif
+            // small payload, or zero-copy is not possible: copy it.
+            return (asend(buffer.data()+offset, size));
         }
     };
 
@@ -167,6 +332,17 @@ namespace fcgi { namespace nix {
             return (1);
         }
 
+        /*!
+         * @brief Obtain the number of threads running handlers in each worker.
+         * @return The number of threads, 0 for one per core.
+         *
+         * Handlers run off the I/O thread, so slow handlers don't hold up
+         * parsing and output for other requests on the same connection.
+         */
+        std::size_t worker_threads () const {
+            return (0);
+        }
+
         /*!
          * @brief Obtain the listener socket.
          * @return The listener socket file descriptor.
@@ -343,12 +519,36 @@ namespace fcgi { namespace nix {
     private:
         int myQuota;
         int myCount;
+        std::size_t myWorkers;
+
+        // handlers run here, and signal completion through the pipe.
+        fcgi::ThreadPool myThreads;
+        int myWakeup[2];
 
         /* construction. */
     public:
         Worker (Server& server)
-            : myQuota(server.worker_quota()), myCount(0)
-        {}
+            : myQuota(server.worker_quota()), myCount(0),
+              myWorkers(server.workers()),
+              myThreads(server.worker_threads())
+        {
+            if (::pipe(myWakeup) == -1)
+            {
+                std::cout
+                    << "[" << ::getpid() << "] "
+                    << "Failed to create pipe: '" << ::strerror(errno) << "'."
+                    << std::endl;
+                throw (std::exception());
+            }
+            ::fcntl(myWakeup[0], F_SETFL, O_NONBLOCK);
+            ::fcntl(myWakeup[1], F_SETFL, O_NONBLOCK);
+        }
+
+        ~Worker ()
+        {
+            ::close(myWakeup[0]);
+            ::close(myWakeup[1]);
+        }
 
         /* operators. */
     public:
@@ -362,21 +562,100 @@ namespace fcgi { namespace nix {
                 << "[" << ::getpid() << "] "
                 << "Creating a session."
                 << std::endl;
-            Session session(stream);
+            Session session(stream, myWorkers, myThreads, myWakeup[1]);
 
             std::cout
                 << "[" << ::getpid() << "] "
                 << "Reading data!"
                 << std::endl;
-            char data[4*1024];
+            fcgi::Buffer buffer;
             ssize_t size = 0;
-            while ((size=::recv(stream,data,sizeof(data),0)) > 0)
+            while (true)
             {
+                // don't read more requests until pending output is sent.
+                ::pollfd events[2];
+                ::pollfd& event = events[0];
+                event.fd = stream;
+                event.events = (session.pending() > 0)? POLLOUT : POLLIN;
+                event.revents = 0;
+                events[1].fd = myWakeup[0];
+                events[1].events = POLLIN;
+                events[1].revents = 0;
+                if (::poll(events, 2, -1) < 0)
+                {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    size = -1; break;
+                }
+                // send output of handlers that ran on the thread pool.
+                if (events[1].revents & POLLIN)
+                {
+                    char signals[64];
+                    while (::read(myWakeup[0], signals, sizeof(signals)) > 0) {
+                    }
+                    session.collect();
+                }
+                if (event.revents == 0) {
+                    continue;
+                }
+                if ((event.revents & POLLERR) && session.reap()) {
+                    continue;
+                }
+                if (event.events == POLLOUT) {
+                    session.resume(); continue;
+                }
+                // re-use the receive buffer unless requests still hold it.
+                if (!buffer.unique()) {
+                    buffer = fcgi::Buffer();
+                }
+                std::string& data = buffer.content();
+                data.resize(4*1024);
+                if ((size=::recv(stream,&data[0],data.size(),0)) <= 0) {
+                    break;
+                }
+                data.resize(size);
                 std::cout
                     << "[" << ::getpid() << "] "
                     << "Received " << size << " bytes."
                     << std::endl;
-                session.feed(data, size);
+                session.feed(buffer);
+
+                // records were lost, the stream can't be used anymore.
+                if (session.broken())
+                {
+                    std::cout
+                        << "[" << ::getpid() << "] "
+                        << "Output lost, closing the connection."
+                        << std::endl;
+                    break;
+                }
+            }
+
+            // Wait for handlers still running on the thread pool.
+            while (session.outstanding() > 0)
+            {
+                ::pollfd event;
+                event.fd = myWakeup[0];
+                event.events = POLLIN;
+                event.revents = 0;
+                ::poll(&event, 1, 1000);
+                char signals[64];
+                while (::read(myWakeup[0], signals, sizeof(signals)) > 0) {
+                }
+                session.collect();
+            }
+
+            // Don't release buffers the kernel may still be sending.
+            while (session.transfers())
+            {
+                ::pollfd event;
+                event.fd = stream;
+                event.events = 0;
+                event.revents = 0;
+                if ((::poll(&event, 1, 1000) <= 0) || !session.reap()) {
+                    break;
+                }
             }
 
             // Validate that last read suceeded.
@@ -39,7 +39,11 @@ namespace {
          */
         Session (w32::net::tcp::Stream stream)
             : myStream(stream)
-        {}
+        {
+            // tell the gateway how many requests to open per connection.
+            const std::size_t requests = concurrent_requests();
+            limits(1, requests, requests > 1);
+        }
 
         /* methods. */
     public:
@@ -51,30 +55,16 @@ namespace {
 
         /* overrides. */
     protected:
-        virtual void asend (const char * data, size_t size)
+        virtual size_t asend (const char * data, size_t size)
         {
-            // push received data.
+            // push received data, the rest stays queued.
             size_t sent = 0;
             size_t pass = 0;
-            while ((pass=myStream.put(data+sent,size-sent)) > 0) {
+            while ((sent < size) &&
+                   ((pass=myStream.put(data+sent,size-sent)) > 0)) {
                 sent += pass;
             }
-
-            // confirm that we were able to send everything.
-            if (sent != size) {
-                std::cout
-                    << "Failed to send entire payload."
-                    << std::endl;
-            }
-        }
-
-        virtual void query
-            (const std::string& name, const std::string& data)
-        {
-            // ...
-            if (concurrent_requests() > 0)
-            {
-            }
+            return (sent);
         }
     };
 